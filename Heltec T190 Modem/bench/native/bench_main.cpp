@@ -0,0 +1,34 @@
+/*
+ * Native benchmark runner: pio run -e native -t exec
+ *
+ * Same kernels as the on-target BENCH command, timed with the host's
+ * monotonic clock. Host numbers compare changes; they don't predict the S3.
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "raptor_bench.h"
+
+#define BENCH_NATIVE_OPS        200000
+
+static uint32_t nanoClock() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void printResult(const BenchResult& result) {
+    char line[96];
+    benchFormat(line, sizeof(line), result);
+    printf("%s\n", line);
+}
+
+int main(int argc, char** argv) {
+    uint32_t ops = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : BENCH_NATIVE_OPS;
+    if (ops == 0) ops = BENCH_NATIVE_OPS;
+
+    printf("RaptorCore native benchmarks, %lu ops per stage, %d byte packets\n",
+           (unsigned long)ops, BENCH_PACKET_LEN);
+    benchRunCore(ops, nanoClock, 1000, printResult);
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <string.h>
+#include "raptor_bench.h"
+#include "raptor_crc.h"
+#include "raptor_frame.h"
+#include "raptor_parse.h"
+#include "raptor_pipeline.h"
+
+volatile uint32_t benchSink = 0;
+
+static RxSlot benchSlot;
+static uint8_t benchFrame[FRAME_MAX_SIZE];
+static const char benchCfgLine[] = "CFG:915.0,96.0,50.0,467.0,32";
+static CommandParser benchParser;
+static uint8_t benchValidPacket[BENCH_PACKET_LEN];     // benchSlot with a RAPT header and a correct CRC32
+
+// Same chain as the firmware's, with the slice8 engine
+typedef RaptorValidator<crc32Slice8> BenchValidator;
+
+const uint8_t* benchPacket() {
+    return benchSlot.data;
+}
+
+// Pseudo-random payload, so stuffing hits escapes at the rate real data would
+static void benchSetup() {
+    uint32_t x = 0x12345678;
+    for (int i = 0; i < BENCH_PACKET_LEN; i++) {
+        x = x * 1664525 + 1013904223;
+        benchSlot.data[i] = x >> 24;
+    }
+    benchSlot.len = BENCH_PACKET_LEN;
+    benchSlot.rssi = -87.5f;
+    benchSlot.snr = 9.25f;
+    benchSlot.rxMicros = 0;
+    memset(&benchParser, 0, sizeof(benchParser));
+
+    memcpy(benchValidPacket, benchSlot.data, BENCH_PACKET_LEN);
+    memcpy(benchValidPacket, "RAPT", 4);
+    benchValidPacket[PIPE_TYPE_OFFSET] = PKT_TYPE_IMAGE_DATA;
+    uint32_t crc = crc32Bitwise(benchValidPacket, BENCH_PACKET_LEN - 4);
+    for (int i = 0; i < 4; i++) {
+        benchValidPacket[BENCH_PACKET_LEN - 4 + i] = (crc >> (24 - 8 * i)) & 0xFF;
+    }
+}
+
+static void benchCrc32Bitwise(uint32_t) {
+    benchSink ^= crc32Bitwise(benchSlot.data, BENCH_PACKET_LEN);
+}
+
+static void benchCrc32Slice8(uint32_t) {
+    benchSink ^= crc32Slice8(benchSlot.data, BENCH_PACKET_LEN);
+}
+
+static void benchFrameV1(uint32_t) {
+    benchSink ^= buildFrame(benchFrame, benchSlot.data, benchSlot.len, benchSlot.rssi, benchSlot.snr);
+}
+
+static void benchFrameV2(uint32_t i) {
+    benchSlot.rxMicros = i;
+    benchSink ^= buildFrameV2(benchFrame, &benchSlot, i);
+}
+
+static void benchValidate(uint32_t) {
+    uint8_t outputClass = 0;
+    benchSink ^= BenchValidator::validate(benchValidPacket, BENCH_PACKET_LEN, &outputClass) + outputClass;
+}
+
+static void benchCfgParse(uint32_t) {
+    RfConfig cfg;
+    if (rfConfigParse(benchCfgLine, &cfg) && rfConfigInvalidField(cfg) == nullptr) {
+        benchSink ^= cfg.preambleLen;
+    }
+}
+
+static void benchCommandFeed(uint32_t) {
+    for (const char* p = benchCfgLine; *p; p++) {
+        commandParserFeed(&benchParser, *p);
+    }
+    benchSink ^= commandParserFeed(&benchParser, '\n');
+}
+
+BenchResult benchMeasure(const char* name, BenchKernel kernel, uint32_t bytesPerOp,
+                         uint32_t ops, BenchClock clock, uint32_t ticksPerUs) {
+    kernel(0);      // Warm caches and, on target, the flash cache
+
+    uint32_t start = clock();
+    for (uint32_t i = 0; i < ops; i++) {
+        kernel(i);
+    }
+    uint32_t ticks = clock() - start;
+
+    BenchResult result = {name, ops, bytesPerOp, ticks, ticksPerUs};
+    return result;
+}
+
+void benchRunCore(uint32_t ops, BenchClock clock, uint32_t ticksPerUs,
+                  void (*report)(const BenchResult& result)) {
+    static const struct {
+        const char* name;
+        BenchKernel kernel;
+        uint32_t bytesPerOp;
+    } kernels[] = {
+        {"crc32-bitwise", benchCrc32Bitwise, BENCH_PACKET_LEN},
+        {"crc32-slice8",  benchCrc32Slice8,  BENCH_PACKET_LEN},
+        {"frame-v1",      benchFrameV1,      BENCH_PACKET_LEN},
+        {"frame-v2",      benchFrameV2,      BENCH_PACKET_LEN},
+        {"validate",      benchValidate,     BENCH_PACKET_LEN},
+        {"cfg-parse",     benchCfgParse,     sizeof(benchCfgLine) - 1},
+        {"cmd-feed",      benchCommandFeed,  sizeof(benchCfgLine)},
+    };
+
+    benchSetup();
+    crc32Slice8Init();
+    crc16Init();
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        report(benchMeasure(kernels[k].name, kernels[k].kernel, kernels[k].bytesPerOp,
+                            ops, clock, ticksPerUs));
+    }
+}
+
+int benchFormat(char* out, size_t size, const BenchResult& result) {
+    double ns = result.ops && result.ticksPerUs ?
+                (double)result.ticks * 1000.0 / result.ticksPerUs / result.ops : 0.0;
+    double mbps = ns > 0 ? result.bytesPerOp * 1000.0 / ns : 0.0;
+    return snprintf(out, size, "%-14s %10.1f ns/op %9.2f MB/s", result.name, ns, mbps);
+}
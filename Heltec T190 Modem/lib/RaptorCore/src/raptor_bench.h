@@ -0,0 +1,42 @@
+/*
+ * Micro-benchmarks for the per-packet hot path
+ *
+ * The caller supplies the clock: the cycle counter on target, a monotonic
+ * nanosecond clock natively. Results are kept in ticks and converted only
+ * for printing.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BENCH_PACKET_LEN        255       // Worst-case packet, every stage sized for it
+
+typedef uint32_t (*BenchClock)();
+typedef void (*BenchKernel)(uint32_t iteration);
+
+struct BenchResult {
+    const char* name;
+    uint32_t ops;
+    uint32_t bytesPerOp;        // 0 for stages where throughput is meaningless
+    uint32_t ticks;             // Elapsed clock ticks for all ops
+    uint32_t ticksPerUs;
+};
+
+// Run kernel `ops` times between two clock reads; must finish before a 32-bit clock wraps
+BenchResult benchMeasure(const char* name, BenchKernel kernel, uint32_t bytesPerOp,
+                         uint32_t ops, BenchClock clock, uint32_t ticksPerUs);
+
+// CRC32 reference/slice8, v1/v2 framing, CFG: parsing and command line assembly
+void benchRunCore(uint32_t ops, BenchClock clock, uint32_t ticksPerUs,
+                  void (*report)(const BenchResult& result));
+
+// Shared packet used by the core kernels, exposed for target-only kernels
+const uint8_t* benchPacket();
+
+// Kernels fold their result in here so the optimizer can't drop them
+extern volatile uint32_t benchSink;
+
+// "<name> <ns/op> ns/op <MB/s> MB/s", no newline; returns snprintf's length
+int benchFormat(char* out, size_t size, const BenchResult& result);
@@ -0,0 +1,65 @@
+#include "raptor_crc.h"
+
+uint32_t crc32Bitwise(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// Only linked in when crc32Slice8() is referenced
+DRAM_ATTR uint32_t crc32Table[8][256];
+
+void crc32Slice8Init() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+        crc32Table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = crc32Table[k - 1][i];
+            crc32Table[k][i] = (prev >> 8) ^ crc32Table[0][prev & 0xFF];
+        }
+    }
+}
+
+uint32_t IRAM_ATTR crc32Slice8(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    // Bytes are assembled by hand: Xtensa faults on unaligned 32-bit loads
+    while (len >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                             ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+        uint32_t hi = (uint32_t)data[4] | ((uint32_t)data[5] << 8) |
+                      ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+        crc = crc32Table[7][lo & 0xFF] ^ crc32Table[6][(lo >> 8) & 0xFF] ^
+              crc32Table[5][(lo >> 16) & 0xFF] ^ crc32Table[4][lo >> 24] ^
+              crc32Table[3][hi & 0xFF] ^ crc32Table[2][(hi >> 8) & 0xFF] ^
+              crc32Table[1][(hi >> 16) & 0xFF] ^ crc32Table[0][hi >> 24];
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ crc32Table[0][(crc ^ *data++) & 0xFF];
+    }
+    return ~crc;
+}
+
+DRAM_ATTR uint16_t crc16Table[256];
+
+void crc16Init() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t crc = i << 8;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+        crc16Table[i] = crc;
+    }
+}
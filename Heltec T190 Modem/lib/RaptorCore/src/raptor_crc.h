@@ -0,0 +1,24 @@
+/*
+ * CRC32 (IEEE 802.3, reflected 0xEDB88320) and CRC16 (CCITT-FALSE)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "raptor_platform.h"
+
+// Reference implementation, 8 iterations/byte
+uint32_t crc32Bitwise(const uint8_t* data, size_t len);
+
+// Slicing-by-8; crc32Slice8Init() fills its 8KB table and must run first
+void crc32Slice8Init();
+uint32_t crc32Slice8(const uint8_t* data, size_t len);
+
+// CRC16-CCITT-FALSE (poly 0x1021, init 0xFFFF) for v2 host frames
+extern uint16_t crc16Table[256];
+void crc16Init();
+
+static inline uint16_t crc16Update(uint16_t crc, uint8_t b) {
+    return (crc << 8) ^ crc16Table[(crc >> 8) ^ b];
+}
@@ -0,0 +1,96 @@
+#include <math.h>
+#include "raptor_crc.h"
+#include "raptor_frame.h"
+
+size_t buildFrame(uint8_t* out, const uint8_t* data, int len, float rssi, float snr) {
+    uint8_t header[FRAME_HEADER_SIZE];
+    int8_t rssiInt = (int8_t)rssi;
+    bool snrNone = isnan(snr);
+    int8_t snrInt = snrNone ? FRAME_V1_SNR_NONE : (int8_t)snr;
+    header[0] = (len >> 8) & 0xFF;
+    header[1] = len & 0xFF;
+    header[2] = (uint8_t)rssiInt;
+    header[3] = (uint8_t)(fabsf(rssi - rssiInt) * 100);
+    header[4] = (uint8_t)snrInt;
+    header[5] = snrNone ? 0 : (uint8_t)(fabsf(snr - snrInt) * 100);
+
+    uint8_t* p = out;
+    uint8_t checksum = 0;
+    *p++ = FRAME_DELIMITER;
+
+    for (int i = 0; i < FRAME_HEADER_SIZE; i++) {
+        checksum ^= header[i];
+        p = stuffByte(p, header[i]);
+    }
+    for (int i = 0; i < len; i++) {
+        checksum ^= data[i];
+        p = stuffByte(p, data[i]);
+    }
+
+    p = stuffByte(p, checksum);
+    *p++ = FRAME_DELIMITER;
+    return p - out;
+}
+
+// Multi-byte fields big-endian; CRC16 covers TAG..DATA before stuffing
+size_t buildFrameV2(uint8_t* out, const RxSlot* slot, uint32_t seq) {
+    uint8_t header[FRAME_V2_HEADER_SIZE];
+    uint64_t rxMicros = (uint64_t)slot->rxMicros;
+    int16_t rssiCdb = frameCdb(slot->rssi);
+    int16_t snrCdb = frameCdb(slot->snr);
+
+    header[0] = FRAME_V2_TAG;
+    header[1] = (slot->len >> 8) & 0xFF;
+    header[2] = slot->len & 0xFF;
+    for (int i = 0; i < 4; i++) {
+        header[3 + i] = (seq >> (24 - 8 * i)) & 0xFF;
+    }
+    for (int i = 0; i < 8; i++) {
+        header[7 + i] = (rxMicros >> (56 - 8 * i)) & 0xFF;
+    }
+    header[15] = ((uint16_t)rssiCdb >> 8) & 0xFF;
+    header[16] = (uint16_t)rssiCdb & 0xFF;
+    header[17] = ((uint16_t)snrCdb >> 8) & 0xFF;
+    header[18] = (uint16_t)snrCdb & 0xFF;
+
+    uint8_t* p = out;
+    uint16_t crc = 0xFFFF;
+    *p++ = FRAME_DELIMITER;
+
+    for (int i = 0; i < FRAME_V2_HEADER_SIZE; i++) {
+        crc = crc16Update(crc, header[i]);
+        p = stuffByte(p, header[i]);
+    }
+    for (int i = 0; i < slot->len; i++) {
+        crc = crc16Update(crc, slot->data[i]);
+        p = stuffByte(p, slot->data[i]);
+    }
+
+    p = stuffByte(p, crc >> 8);
+    p = stuffByte(p, crc & 0xFF);
+    *p++ = FRAME_DELIMITER;
+    return p - out;
+}
+
+// Same stuffing and CRC16 as v2; CRC covers TAG..PAYLOAD
+size_t buildTaggedFrame(uint8_t* out, uint8_t tag, const uint8_t* payload, uint16_t len) {
+    uint8_t header[3] = { tag, (uint8_t)(len >> 8), (uint8_t)(len & 0xFF) };
+
+    uint8_t* p = out;
+    uint16_t crc = 0xFFFF;
+    *p++ = FRAME_DELIMITER;
+
+    for (int i = 0; i < 3; i++) {
+        crc = crc16Update(crc, header[i]);
+        p = stuffByte(p, header[i]);
+    }
+    for (int i = 0; i < len; i++) {
+        crc = crc16Update(crc, payload[i]);
+        p = stuffByte(p, payload[i]);
+    }
+
+    p = stuffByte(p, crc >> 8);
+    p = stuffByte(p, crc & 0xFF);
+    *p++ = FRAME_DELIMITER;
+    return p - out;
+}
@@ -0,0 +1,61 @@
+/*
+ * USB host framing
+ *
+ *   v1: [0x7E][LEN:2][RSSI_INT][RSSI_FRAC][SNR_INT][SNR_FRAC][DATA...][XOR][0x7E]
+ *   v2: [0x7E][0xA2][LEN:2][SEQ:4][RX_US:8][RSSI_CDB:2][SNR_CDB:2][DATA...][CRC16:2][0x7E]
+ *   tagged: [0x7E][TAG][LEN:2][PAYLOAD...][CRC16:2][0x7E], e.g. binary stats
+ *
+ * 0x7E/0x7D inside a frame are sent as 0x7D, byte ^ 0x20.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_PACKET_SIZE         255
+#define FRAME_DELIMITER         0x7E
+#define FRAME_ESCAPE            0x7D
+#define FRAME_HEADER_SIZE       6         // LEN_HI LEN_LO RSSI_INT RSSI_FRAC SNR_INT SNR_FRAC
+#define FRAME_V2_TAG            0xA2      // Never a valid v1 LEN_HI, so v1 parsers reject it
+#define FRAME_V2_HEADER_SIZE    19        // TAG LEN:2 SEQ:4 RX_US:8 RSSI:2 SNR:2
+#define FRAME_STATS_TAG         0xA5      // Binary stats report, also never a valid v1 LEN_HI
+#define FRAME_LAT_TAG           0xA6      // Full latency histograms, sent on LAT:BIN
+#define FRAME_IMAGE_TAG         0xA7      // One chunk of an image reconstructed on the modem
+#define FRAME_CDB_NONE          INT16_MIN // 0.01 dB field with no value, e.g. SNR in GFSK
+#define FRAME_V1_SNR_NONE       INT8_MIN  // v1 SNR_INT with no value, SNR_FRAC 0
+#define FRAME_TAGGED_MAX_SIZE(len)  (2 + 2 * (3 + (len) + 2))   // Every byte stuffed
+#define FRAME_MAX_SIZE      (2 + 2 * (FRAME_V2_HEADER_SIZE + MAX_PACKET_SIZE + 2))  // Every byte stuffed
+
+// One received packet as it moves through the pipeline
+struct RxSlot {
+    int64_t rxMicros;       // esp_timer time DIO1 fired for this packet
+    uint16_t len;
+    float rssi;
+    float snr;              // NaN: none (GFSK)
+    bool injected;          // Generated by the INJ: test mode rather than received
+    uint8_t data[MAX_PACKET_SIZE];
+};
+
+// dB to signed 0.01 dB, NaN to FRAME_CDB_NONE
+static inline int16_t frameCdb(float db) {
+    if (isnan(db)) return FRAME_CDB_NONE;
+    return (int16_t)lroundf(db * 100.0f);
+}
+
+static inline uint8_t* stuffByte(uint8_t* p, uint8_t b) {
+    if (b == FRAME_DELIMITER || b == FRAME_ESCAPE) {
+        *p++ = FRAME_ESCAPE;
+        *p++ = b ^ 0x20;    // 0x7E -> 0x5E, 0x7D -> 0x5D
+    } else {
+        *p++ = b;
+    }
+    return p;
+}
+
+// Stuff, checksum and delimit one packet into out[] in a single pass; returns frame length.
+// out[] must hold FRAME_MAX_SIZE bytes.
+size_t buildFrame(uint8_t* out, const uint8_t* data, int len, float rssi, float snr);
+size_t buildFrameV2(uint8_t* out, const RxSlot* slot, uint32_t seq);
+size_t buildTaggedFrame(uint8_t* out, uint8_t tag, const uint8_t* payload, uint16_t len);
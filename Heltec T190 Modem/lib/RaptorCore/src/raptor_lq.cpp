@@ -0,0 +1,221 @@
+#include <string.h>
+#include "raptor_lq.h"
+
+#define LQ_SECOND_SLOTS     (LQ_SECONDS + 1)
+#define LQ_MINUTE_SLOTS     (LQ_MINUTES + 1)
+
+void lqInit(LqStats* s, uint32_t gapThresholdMs) {
+    memset(s, 0, sizeof(*s));
+    s->gapThresholdMs = gapThresholdMs;
+}
+
+// Clear the slots between the last one filled and now; a jump past the whole ring clears it
+static void lqClear(LqCounts* ring, size_t slots, uint32_t from, uint32_t to) {
+    uint32_t steps = to - from;
+    if (steps >= slots) {
+        memset(ring, 0, slots * sizeof(ring[0]));
+        return;
+    }
+    for (uint32_t i = 1; i <= steps; i++) {
+        memset(&ring[(from + i) % slots], 0, sizeof(ring[0]));
+    }
+}
+
+static void lqAdvance(LqStats* s, uint32_t nowMs) {
+    uint32_t second = nowMs / 1000;
+    uint32_t minute = second / 60;
+    if (!s->started) {
+        s->second = second;
+        s->minute = minute;
+        s->started = true;
+        return;
+    }
+
+    if (second != s->second) {
+        lqClear(s->seconds, LQ_SECOND_SLOTS, s->second, second);
+        s->second = second;
+    }
+    if (minute != s->minute) {
+        lqClear(s->minutes, LQ_MINUTE_SLOTS, s->minute, minute);
+        if (minute - s->minute >= 2) {
+            memset(s->rssiHist, 0, sizeof(s->rssiHist));
+        } else {
+            memset(s->rssiHist[minute & 1], 0, sizeof(s->rssiHist[0]));
+        }
+        s->minute = minute;
+    }
+}
+
+static inline void lqAdd(LqCounts* c, uint32_t good, uint32_t lost, uint32_t bad) {
+    c->good += good;
+    c->lost += lost;
+    c->bad += bad;
+}
+
+static void lqCount(LqStats* s, uint32_t good, uint32_t lost, uint32_t bad) {
+    lqAdd(&s->seconds[s->second % LQ_SECOND_SLOTS], good, lost, bad);
+    lqAdd(&s->minutes[s->minute % LQ_MINUTE_SLOTS], good, lost, bad);
+    lqAdd(&s->total, good, lost, bad);
+}
+
+// Lost packets that fall in seconds from+1 .. k when `lost` is spread evenly up to from+span
+static inline uint32_t lqBooked(uint32_t lost, uint32_t from, uint32_t span, uint32_t k) {
+    return (uint32_t)((uint64_t)lost * (k - from) / span);
+}
+
+// Book `lost` evenly over the seconds after fromSecond up to the current one; the share of
+// seconds that have left the ring still goes to their minute and to the total
+static void lqBookLost(LqStats* s, uint32_t lost, uint32_t fromSecond) {
+    uint32_t to = s->second;
+    uint32_t span = to - fromSecond;
+    if ((int32_t)span <= 1) {
+        lqCount(s, 0, lost, 0);
+        return;
+    }
+
+    uint32_t first = span > LQ_SECONDS ? to - LQ_SECONDS : fromSecond + 1;
+    for (uint32_t k = first; k <= to; k++) {
+        s->seconds[k % LQ_SECOND_SLOTS].lost += lqBooked(lost, fromSecond, span, k) - lqBooked(lost, fromSecond, span, k - 1);
+    }
+    uint32_t fromMinute = (fromSecond + 1) / 60;
+    uint32_t firstMinute = s->minute - fromMinute > LQ_MINUTES ? s->minute - LQ_MINUTES : fromMinute;
+    for (uint32_t m = firstMinute; m <= s->minute; m++) {
+        uint32_t lo = m * 60 > fromSecond + 1 ? m * 60 : fromSecond + 1;
+        uint32_t hi = m * 60 + 59 < to ? m * 60 + 59 : to;
+        s->minutes[m % LQ_MINUTE_SLOTS].lost += lqBooked(lost, fromSecond, span, hi) - lqBooked(lost, fromSecond, span, lo - 1);
+    }
+    s->total.lost += lost;
+}
+
+static inline void lqHistAdd(uint16_t* hist, int buckets, int minValue, float value) {
+    int b = (int)(value - minValue + 0.5f);
+    if (b < 0) b = 0;
+    if (b >= buckets) b = buckets - 1;
+    if (hist[b] < UINT16_MAX) hist[b]++;
+}
+
+bool lqRecordPacket(LqStats* s, uint16_t seq, float rssi, uint32_t nowMs) {
+    lqAdvance(s, nowMs);
+
+    bool gap = s->haveSeq && nowMs - s->lastPacketMs >= s->gapThresholdMs;
+    uint32_t lost = 0;
+    bool repeat = false;
+    if (s->haveSeq) {
+        uint16_t delta = seq - s->lastSeq;
+        if (delta == 0) {
+            repeat = true;              // Same packet again, only possible with dedup off
+        } else if (delta <= LQ_SEQ_WINDOW) {
+            lost = delta - 1;
+        } else {
+            s->resyncs++;
+        }
+    }
+    s->haveSeq = true;
+    s->lastSeq = seq;
+
+    if (!repeat) {
+        lqCount(s, 1, 0, 0);
+        if (lost > 0) lqBookLost(s, lost, s->lastPacketMs / 1000);
+        lqHistAdd(s->rssiHist[s->minute & 1], LQ_RSSI_BUCKETS, LQ_RSSI_MIN_DBM, rssi);
+    }
+
+    if (gap) {
+        s->gaps++;
+        s->lastGapMs = nowMs - s->lastPacketMs;
+        s->lastGapLost = lost;
+        if (s->lastGapMs > s->longestGapMs) s->longestGapMs = s->lastGapMs;
+    }
+    s->lastPacketMs = nowMs;
+    return gap;
+}
+
+void lqRecordBad(LqStats* s, uint32_t nowMs) {
+    lqAdvance(s, nowMs);
+    lqCount(s, 0, 0, 1);
+}
+
+// Slot for absolute index `target`, or nullptr if the writer has not reached it or it has left the ring
+static const LqCounts* lqSlot(const LqCounts* ring, size_t slots, uint32_t filling, uint32_t target) {
+    if ((int32_t)(target - filling) > 0 || filling - target >= slots) return nullptr;
+    return &ring[target % slots];
+}
+
+LqCounts lqSecond(const LqStats* s, uint32_t ago, uint32_t nowMs) {
+    LqCounts c = {0, 0, 0};
+    if (!s->started || ago >= LQ_SECOND_SLOTS || ago > nowMs / 1000) return c;
+    const LqCounts* slot = lqSlot(s->seconds, LQ_SECOND_SLOTS, s->second, nowMs / 1000 - ago);
+    return slot != nullptr ? *slot : c;
+}
+
+LqCounts lqWindow(const LqStats* s, uint32_t seconds, uint32_t nowMs) {
+    LqCounts sum = {0, 0, 0};
+    if (seconds > LQ_SECONDS) seconds = LQ_SECONDS;
+    for (uint32_t ago = 1; ago <= seconds; ago++) {
+        LqCounts c = lqSecond(s, ago, nowMs);
+        lqAdd(&sum, c.good, c.lost, c.bad);
+    }
+    return sum;
+}
+
+LqCounts lqMinute(const LqStats* s, uint32_t ago, uint32_t nowMs) {
+    LqCounts c = {0, 0, 0};
+    if (!s->started || ago >= LQ_MINUTE_SLOTS || ago > nowMs / 60000) return c;
+    const LqCounts* slot = lqSlot(s->minutes, LQ_MINUTE_SLOTS, s->minute, nowMs / 60000 - ago);
+    return slot != nullptr ? *slot : c;
+}
+
+float lqPer(const LqCounts& c) {
+    uint32_t expected = c.good + c.lost;
+    return expected > 0 ? 100.0f * c.lost / expected : 0.0f;
+}
+
+// Smallest bucket value with at least pct % of the samples at or below it
+static int16_t lqPercentile(const uint16_t* a, const uint16_t* b, int buckets, int minValue,
+                            uint32_t count, uint32_t pct) {
+    uint32_t rank = (count * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+    uint32_t seen = 0;
+    for (int i = 0; i < buckets; i++) {
+        seen += (a ? a[i] : 0) + (b ? b[i] : 0);
+        if (seen >= rank) return (int16_t)(minValue + i);
+    }
+    return (int16_t)(minValue + buckets - 1);
+}
+
+void lqSignal(const LqStats* s, uint32_t nowMs, LqSignal* out) {
+    memset(out, 0, sizeof(*out));
+    if (!s->started) return;
+
+    // Histograms of the minute being filled and the one before, if they are still that recent
+    uint32_t nowMinute = nowMs / 60000;
+    const uint16_t* rssi[2] = { nullptr, nullptr };
+    for (uint32_t back = 0; back < 2; back++) {
+        uint32_t minute = s->minute - back;
+        if (nowMinute - minute > 1) continue;
+        rssi[back] = s->rssiHist[minute & 1];
+    }
+
+    uint32_t count = 0;
+    for (int i = 0; i < LQ_RSSI_BUCKETS; i++) {
+        count += (rssi[0] ? rssi[0][i] : 0) + (rssi[1] ? rssi[1][i] : 0);
+    }
+    out->count = count;
+    if (count == 0) return;
+
+    static const uint32_t pcts[3] = { 10, 50, 90 };
+    for (int i = 0; i < 3; i++) {
+        out->rssi[i] = lqPercentile(rssi[0], rssi[1], LQ_RSSI_BUCKETS, LQ_RSSI_MIN_DBM, count, pcts[i]);
+    }
+}
+
+uint32_t lqSilenceMs(const LqStats* s, uint32_t nowMs) {
+    return s->haveSeq ? nowMs - s->lastPacketMs : 0;
+}
+
+bool lqQuiet(const LqStats* s, uint32_t nowMs) {
+    return s->haveSeq && nowMs - s->lastPacketMs >= s->gapThresholdMs;
+}
+
+uint32_t lqQuietSecond(const LqStats* s) {
+    return s->lastPacketMs / 1000 + 1;
+}
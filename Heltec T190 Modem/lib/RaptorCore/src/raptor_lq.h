@@ -0,0 +1,91 @@
+/*
+ * Rolling link-quality statistics from the RaptorHAB header sequence
+ *
+ * Fixed memory: per-second and per-minute counters in rings, and 1 dB
+ * RSSI histograms for the current and the previous minute. The
+ * transmitter numbers every packet from one 16-bit counter, so a forward
+ * jump in SEQ is the number of packets lost over the air, whether they
+ * failed CRC or were never detected. The loss is spread evenly over the
+ * seconds between the two packets, so an outage shows where it happened.
+ * Time is passed in as milliseconds.
+ *
+ * One writer; readers go by their own clock and treat seconds the writer
+ * has not reached yet as empty, so nothing is modified on a read. Those
+ * seconds are only known once the next packet arrives, so while lqQuiet()
+ * holds an empty window means no data, not a clean link.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LQ_SECONDS              60        // Per-second history (sparkline, 60 s PER)
+#define LQ_MINUTES              60        // Per-minute history
+#define LQ_SEQ_WINDOW           1024      // A larger jump, or going backwards, is a transmitter restart
+#define LQ_RSSI_MIN_DBM         -160
+#define LQ_RSSI_BUCKETS         128       // 1 dB each, -160 to -33 dBm
+
+struct LqCounts {
+    uint32_t good;              // Valid packets with a new sequence number
+    uint32_t lost;              // Sequence numbers skipped
+    uint32_t bad;               // CRC failures (their sequence numbers also show up as lost)
+};
+
+struct LqSignal {
+    uint32_t count;             // Samples in the current and previous minute
+    int16_t rssi[3];            // p10 / p50 / p90, dBm
+};
+
+struct LqStats {
+    LqCounts seconds[LQ_SECONDS + 1];       // History plus the one being filled
+    LqCounts minutes[LQ_MINUTES + 1];
+    uint16_t rssiHist[2][LQ_RSSI_BUCKETS];  // Indexed by minute & 1
+    uint32_t second;            // Absolute second being filled
+    uint32_t minute;            // Absolute minute being filled
+    bool started;
+
+    bool haveSeq;
+    uint16_t lastSeq;
+    uint32_t resyncs;           // Sequence restarts, not counted as loss
+    LqCounts total;
+
+    uint32_t gapThresholdMs;    // Silence this long counts as a gap
+    uint32_t lastPacketMs;
+    uint32_t gaps;
+    uint32_t longestGapMs;
+    uint32_t lastGapMs;         // Set by the packet that ended the gap
+    uint32_t lastGapLost;
+};
+
+void lqInit(LqStats* s, uint32_t gapThresholdMs);
+
+// Valid packet; returns true if it ended a gap (lastGapMs / lastGapLost describe it)
+bool lqRecordPacket(LqStats* s, uint16_t seq, float rssi, uint32_t nowMs);
+
+// Packet that failed CRC
+void lqRecordBad(LqStats* s, uint32_t nowMs);
+
+// Counts of the second `ago` seconds before the current one, 0 = the one still filling
+LqCounts lqSecond(const LqStats* s, uint32_t ago, uint32_t nowMs);
+
+// Sum of the last `seconds` complete seconds
+LqCounts lqWindow(const LqStats* s, uint32_t seconds, uint32_t nowMs);
+
+// Counts of the minute `ago` minutes before the current one
+LqCounts lqMinute(const LqStats* s, uint32_t ago, uint32_t nowMs);
+
+// Packet error rate in percent, lost / (good + lost); 0 with nothing expected
+float lqPer(const LqCounts& c);
+
+// RSSI percentiles over the current and the previous minute
+void lqSignal(const LqStats* s, uint32_t nowMs, LqSignal* out);
+
+// Milliseconds since the last valid packet, 0 before the first
+uint32_t lqSilenceMs(const LqStats* s, uint32_t nowMs);
+
+// No valid packet for at least the gap threshold: the seconds since are unknown
+bool lqQuiet(const LqStats* s, uint32_t nowMs);
+
+// First second (absolute, ms / 1000) with nothing known, valid while lqQuiet()
+uint32_t lqQuietSecond(const LqStats* s);
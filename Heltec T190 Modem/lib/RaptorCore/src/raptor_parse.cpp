@@ -0,0 +1,59 @@
+#include <stdlib.h>
+#include <string.h>
+#include "raptor_parse.h"
+
+// Parse one float field terminated by `end`; advances *p past the terminator
+static bool parseConfigField(const char** p, char end, float* value) {
+    char* stop;
+    *value = strtof(*p, &stop);
+    if (stop == *p || *stop != end) return false;
+    *p = stop + (end != '\0');
+    return true;
+}
+
+bool rfConfigParse(const char* cmd, RfConfig* cfg) {
+    if (strncmp(cmd, "CFG:", 4) != 0) return false;
+
+    const char* p = cmd + 4;
+    float freq, bitrate, deviation, bandwidth, preambleValue;
+    if (!parseConfigField(&p, ',', &freq) ||
+        !parseConfigField(&p, ',', &bitrate) ||
+        !parseConfigField(&p, ',', &deviation) ||
+        !parseConfigField(&p, ',', &bandwidth) ||
+        !parseConfigField(&p, '\0', &preambleValue)) {
+        return false;
+    }
+
+    cfg->frequency = freq;
+    cfg->bitrate = bitrate;
+    cfg->deviation = deviation;
+    cfg->rxBandwidth = bandwidth;
+    cfg->preambleLen = preambleValue >= 0 && preambleValue <= 65535 ? (uint16_t)preambleValue : 0;
+    return true;
+}
+
+const char* rfConfigInvalidField(const RfConfig& cfg) {
+    if (cfg.frequency < 150.0 || cfg.frequency > 960.0) return "frequency";
+    if (cfg.bitrate < 1.0 || cfg.bitrate > 300.0) return "bitrate";
+    if (cfg.deviation < 1.0 || cfg.deviation > 200.0) return "deviation";
+    if (cfg.rxBandwidth < 10.0 || cfg.rxBandwidth > 500.0) return "bandwidth";
+    if (cfg.preambleLen < 8) return "preamble";
+    return nullptr;
+}
+
+CommandFeedResult commandParserFeed(CommandParser* parser, char c) {
+    if (c == '\n' || c == '\r') {
+        CommandFeedResult result = parser->overflow ? COMMAND_TOO_LONG :
+                                   parser->len > 0 ? COMMAND_READY : COMMAND_PENDING;
+        parser->line[parser->len] = '\0';
+        parser->len = 0;
+        parser->overflow = false;
+        return result;
+    }
+    if (parser->len < HOST_CMD_MAX_LEN - 1) {
+        parser->line[parser->len++] = c;
+    } else {
+        parser->overflow = true;
+    }
+    return COMMAND_PENDING;
+}
@@ -0,0 +1,40 @@
+/*
+ * Host command parsing: line assembly and the CFG: radio settings
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define HOST_CMD_MAX_LEN        96
+
+struct RfConfig {
+    float frequency;
+    float bitrate;
+    float deviation;
+    float rxBandwidth;
+    uint16_t preambleLen;
+};
+
+// Parse CFG:<freq>,<bitrate>,<deviation>,<bandwidth>,<preamble>; false on a syntax error.
+// Ranges are not checked, see rfConfigInvalidField().
+bool rfConfigParse(const char* cmd, RfConfig* cfg);
+
+// nullptr when every field is in range, otherwise the name of the first bad one
+const char* rfConfigInvalidField(const RfConfig& cfg);
+
+// Fixed line buffer fed one byte at a time; no heap, no blocking.
+// Overlong lines are discarded up to the next terminator.
+struct CommandParser {
+    char line[HOST_CMD_MAX_LEN];
+    uint8_t len;
+    bool overflow;
+};
+
+enum CommandFeedResult {
+    COMMAND_PENDING,        // Mid-line, or an empty line
+    COMMAND_READY,          // parser->line holds a NUL-terminated line
+    COMMAND_TOO_LONG        // Terminator ended a line that did not fit; it was dropped
+};
+
+CommandFeedResult commandParserFeed(CommandParser* parser, char c);
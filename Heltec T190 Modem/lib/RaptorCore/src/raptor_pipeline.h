@@ -0,0 +1,100 @@
+/*
+ * Compile-time packet validation chain
+ *
+ * Each stage is a type with a static inline member, and RxValidator strings
+ * them together: sync check -> integrity check -> classifier. A build picks
+ * its stages in one typedef, so the chain compiles to straight-line code with
+ * no function pointers and no branches for stages it does not use. The
+ * fixed output sinks a build carries are strung together the same way;
+ * sinks added at run time are the firmware's business.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// RaptorHAB packet layout: [RAPT][TYPE][SEQ:2][FLAGS][PAYLOAD...][CRC32:4]
+#define PKT_HEADER_SIZE         8
+#define PKT_MIN_SIZE            12        // Header + CRC32
+#define PKT_TYPE_TELEMETRY      0x00
+#define PKT_TYPE_IMAGE_META     0x01      // image_id:2 total_size:4 symbol_size:2 num_source_symbols:2 ...
+#define PKT_TYPE_IMAGE_DATA     0x02      // image_id:2 symbol_id:4 symbol...
+#define PKT_TYPE_TEXT           0x03
+#define PKT_TYPE_CMD_ACK        0x10
+#define PIPE_TYPE_OFFSET        4
+
+#define OUTPUT_CLASS_PRIORITY   0         // Telemetry, command ACK, text, image metadata
+#define OUTPUT_CLASS_BULK       1         // Image data (RaptorQ symbols)
+#define OUTPUT_CLASS_COUNT      2
+
+enum PipeVerdict {
+    PIPE_ACCEPT,
+    PIPE_REJECT_SYNC,           // Too short, or not a RaptorHAB packet
+    PIPE_REJECT_CHECK           // Integrity check failed
+};
+
+// "RAPT" at the start and at least Len bytes; MinLen is what later stages may rely on
+template <uint16_t Len>
+struct RaptSync {
+    static_assert(Len >= 4, "RaptSync reads the four sync bytes");
+    static const uint16_t MinLen = Len;
+
+    static inline bool pass(const uint8_t* p, uint16_t len) {
+        return len >= MinLen && p[0] == 0x52 && p[1] == 0x41 && p[2] == 0x50 && p[3] == 0x54;
+    }
+};
+
+// Big-endian CRC32 in the last 4 bytes, over everything before it; Crc is resolved at compile time
+template <uint32_t (*Crc)(const uint8_t*, size_t)>
+struct Crc32Trailer {
+    static const uint16_t MinLen = 4;
+
+    static inline bool pass(const uint8_t* p, uint16_t len) {
+        uint32_t received = ((uint32_t)p[len - 4] << 24) | ((uint32_t)p[len - 3] << 16) |
+                            ((uint32_t)p[len - 2] << 8) | p[len - 1];
+        return received == Crc(p, len - 4);
+    }
+};
+
+// Packets of BulkType get BulkClass, everything else OtherClass
+template <uint8_t BulkType, uint8_t BulkClass, uint8_t OtherClass>
+struct TypeClassifier {
+    static inline uint8_t classify(const uint8_t* p) {
+        return p[PIPE_TYPE_OFFSET] == BulkType ? BulkClass : OtherClass;
+    }
+};
+
+template <class Sync, class Check, class Classifier>
+struct RxValidator {
+    static_assert(Sync::MinLen >= Check::MinLen, "Sync must reject packets too short for the check");
+    static_assert(Sync::MinLen > PIPE_TYPE_OFFSET, "Sync must reject packets without a type byte");
+
+    // outputClass is only written for PIPE_ACCEPT
+    static inline PipeVerdict validate(const uint8_t* p, uint16_t len, uint8_t* outputClass) {
+        if (!Sync::pass(p, len)) return PIPE_REJECT_SYNC;
+        if (!Check::pass(p, len)) return PIPE_REJECT_CHECK;
+        *outputClass = Classifier::classify(p);
+        return PIPE_ACCEPT;
+    }
+};
+
+// The RaptorHAB chain; only the CRC32 engine differs between the firmware and the bench
+template <uint32_t (*Crc)(const uint8_t*, size_t)>
+using RaptorValidator = RxValidator<RaptSync<PKT_MIN_SIZE>,
+                                    Crc32Trailer<Crc>,
+                                    TypeClassifier<PKT_TYPE_IMAGE_DATA, OUTPUT_CLASS_BULK, OUTPUT_CLASS_PRIORITY> >;
+
+// Output sinks fixed at build time; each stage has a static offer()
+struct SinkNone {
+    static inline void offer(uint8_t, uint8_t, bool) {}
+};
+
+// Offers to Head, then to the rest of the set
+template <class Head, class Tail>
+struct SinkChain {
+    static inline void offer(uint8_t ref, uint8_t outputClass, bool imageRebuilt) {
+        Head::offer(ref, outputClass, imageRebuilt);
+        Tail::offer(ref, outputClass, imageRebuilt);
+    }
+};
@@ -0,0 +1,19 @@
+/*
+ * RaptorCore - hardware-independent pieces of the modem firmware
+ *
+ * Placement attributes are no-ops off-target so the same sources build for
+ * the ESP32-S3 and for the native benchmark environment.
+ */
+
+#pragma once
+
+#if defined(ESP_PLATFORM)
+  #include <esp_attr.h>
+#else
+  #ifndef IRAM_ATTR
+    #define IRAM_ATTR
+  #endif
+  #ifndef DRAM_ATTR
+    #define DRAM_ATTR
+  #endif
+#endif
@@ -0,0 +1,104 @@
+#include <string.h>
+#include "raptor_sched.h"
+
+// Signed difference so a wrapping 32-bit clock still compares correctly
+static inline bool schedReached(uint32_t now, uint32_t due) {
+    return (int32_t)(now - due) >= 0;
+}
+
+void schedInit(Scheduler* s, uint32_t passBudgetUs, SchedClock clock, SchedYield shouldYield) {
+    memset(s, 0, sizeof(*s));
+    s->passBudgetUs = passBudgetUs;
+    s->clock = clock;
+    s->shouldYield = shouldYield;
+}
+
+SchedJob* schedAdd(Scheduler* s, const char* name, SchedRun run, uint8_t priority,
+                   uint32_t periodUs, uint32_t budgetUs) {
+    if (s->count >= SCHED_MAX_JOBS) return nullptr;
+
+    SchedJob* job = &s->jobs[s->count];
+    memset(job, 0, sizeof(*job));
+    job->name = name;
+    job->run = run;
+    job->priority = priority;
+    job->periodUs = periodUs;
+    job->budgetUs = budgetUs;
+    job->enabled = true;
+    job->nextDue = s->clock() + periodUs;
+
+    // Equal priorities keep the order they were added in
+    size_t pos = s->count;
+    for (; pos > 0 && s->jobs[s->order[pos - 1]].priority < priority; pos--) s->order[pos] = s->order[pos - 1];
+    s->order[pos] = (uint8_t)s->count;
+    s->count++;
+    return job;
+}
+
+void schedPass(Scheduler* s) {
+    uint32_t start = s->clock();
+    bool ran = false;
+    bool yielding = false;
+
+    for (size_t i = 0; i < s->count; i++) {
+        SchedJob* job = &s->jobs[s->order[i]];
+        uint32_t now = s->clock();
+        if (!job->enabled || (job->periodUs != SCHED_IDLE && !schedReached(now, job->nextDue))) continue;
+
+        if (ran) {
+            if (!yielding && s->shouldYield != nullptr && s->shouldYield()) {
+                yielding = true;
+                s->yields++;
+            }
+            if (yielding) {
+                // The rest of the pass is left to the packet path, but not forever
+                if (job->yieldSkips < SCHED_MAX_YIELD_SKIPS) {
+                    job->yieldSkips++;
+                    job->deferred++;
+                    continue;
+                }
+                job->forced++;
+            } else if (!job->held && now - start + job->budgetUs > s->passBudgetUs) {
+                job->held = true;
+                job->deferred++;
+                continue;
+            }
+        }
+
+        job->run();
+        uint32_t end = s->clock();
+        uint32_t elapsed = end - now;
+        job->held = false;
+        job->yieldSkips = 0;
+        job->runs++;
+        if (elapsed > job->maxUs) job->maxUs = elapsed;
+        if (elapsed > job->budgetUs) job->overruns++;
+        if (job->periodUs != SCHED_IDLE) {
+            job->nextDue += job->periodUs;
+            if (schedReached(end, job->nextDue)) job->nextDue = end + job->periodUs;
+        }
+        ran = true;
+    }
+
+    uint32_t elapsed = s->clock() - start;
+    if (elapsed > s->maxPassUs) s->maxPassUs = elapsed;
+    s->passes++;
+}
+
+uint32_t schedNextDueUs(const Scheduler* s) {
+    uint32_t now = s->clock();
+    uint32_t wait = SCHED_NO_DEADLINE;
+    for (size_t i = 0; i < s->count; i++) {
+        const SchedJob* job = &s->jobs[i];
+        if (!job->enabled || job->periodUs == SCHED_IDLE) continue;
+        if (schedReached(now, job->nextDue)) return 0;
+        if (job->nextDue - now < wait) wait = job->nextDue - now;
+    }
+    return wait;
+}
+
+void schedSetPeriod(const Scheduler* s, SchedJob* job, uint32_t periodUs) {
+    job->periodUs = periodUs;
+    job->nextDue = s->clock() + periodUs;
+    job->held = false;
+}
@@ -0,0 +1,69 @@
+/*
+ * Cooperative scheduler for loop() housekeeping
+ *
+ * Jobs are plain functions that return quickly. A pass runs the jobs that are
+ * due in priority order until the pass budget is spent or the yield check
+ * reports work for the packet path. The caller supplies a microsecond clock,
+ * micros() on target.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHED_MAX_JOBS          8
+#define SCHED_IDLE              0         // periodUs for a job that runs on every pass with budget left
+#define SCHED_NO_DEADLINE       0xFFFFFFFFu
+#define SCHED_MAX_YIELD_SKIPS   8         // Passes in a row a due job may be left for the packet path
+
+typedef uint32_t (*SchedClock)();
+typedef bool (*SchedYield)();
+typedef void (*SchedRun)();
+
+struct SchedJob {
+    const char* name;
+    SchedRun run;
+    uint8_t priority;           // Higher runs first
+    uint32_t periodUs;          // SCHED_IDLE or the period; missed periods are not caught up
+    uint32_t budgetUs;          // Expected worst case for one run
+    bool enabled;
+
+    // Kept by the scheduler
+    uint32_t nextDue;
+    bool held;                  // Deferred last pass, skips the budget check on the next one
+    uint8_t yieldSkips;         // Due, but left to a yield, this many passes in a row
+    uint32_t runs;
+    uint32_t overruns;          // Runs longer than budgetUs
+    uint32_t deferred;          // Due, but left for a later pass (budget or yield)
+    uint32_t forced;            // Run despite a yield after SCHED_MAX_YIELD_SKIPS skips
+    uint32_t maxUs;
+};
+
+struct Scheduler {
+    SchedJob jobs[SCHED_MAX_JOBS];      // In the order added; job pointers stay valid
+    uint8_t order[SCHED_MAX_JOBS];      // Indexes into jobs, highest priority first
+    size_t count;
+    uint32_t passBudgetUs;
+    SchedClock clock;
+    SchedYield shouldYield;     // nullptr = never yield
+    uint32_t passes;
+    uint32_t yields;            // Passes cut short by shouldYield()
+    uint32_t maxPassUs;
+};
+
+void schedInit(Scheduler* s, uint32_t passBudgetUs, SchedClock clock, SchedYield shouldYield);
+
+// Register an enabled job, due one period from now; nullptr once SCHED_MAX_JOBS are registered
+SchedJob* schedAdd(Scheduler* s, const char* name, SchedRun run, uint8_t priority,
+                   uint32_t periodUs, uint32_t budgetUs);
+
+// Run due jobs; the first one always runs so a long job cannot starve, and a job a
+// yield has skipped SCHED_MAX_YIELD_SKIPS passes in a row runs on the next one
+void schedPass(Scheduler* s);
+
+// Microseconds until the next periodic job is due, 0 if one is due now, SCHED_NO_DEADLINE if none is armed
+uint32_t schedNextDueUs(const Scheduler* s);
+
+// Change a job's period and re-arm it one period from now
+void schedSetPeriod(const Scheduler* s, SchedJob* job, uint32_t periodUs);
@@ -0,0 +1,291 @@
+/*
+ * Bluetooth LE transport (Nordic UART Service)
+ */
+
+#include "modem.h"
+#if ENABLE_BLE
+#include <NimBLEDevice.h>
+#endif
+
+// ============================================================================
+// Bluetooth LE Transport (Nordic UART Service)
+// ============================================================================
+
+// BLE link state (written from NimBLE host callbacks)
+volatile bool bleConnected = false;
+volatile uint16_t bleConnHandle = 0;
+volatile uint16_t bleMtu = 23;
+uint32_t blePacketsSent = 0;
+uint32_t bleNotifications = 0;
+uint32_t bleNotifyErrors = 0;
+volatile uint32_t bleLastErrorMs = 0;
+uint32_t bleShed = 0;                   // Image symbols not sent on a congested BLE link
+
+#if ENABLE_BLE
+
+NimBLEServer* bleServer = nullptr;
+NimBLECharacteristic* bleTxChar = nullptr;
+QueueHandle_t bleCmdQueue = nullptr;
+
+// Owned by the forward task; PKB header is filled in at flush time
+uint8_t bleBatch[BLE_NOTIFY_MAX];
+size_t bleBatchLen = 0;             // Record bytes after BLE_BATCH_HEADER
+uint8_t bleBatchCount = 0;
+
+class BleServerCallbacks : public NimBLEServerCallbacks {
+    void onConnect(NimBLEServer* server, ble_gap_conn_desc* desc) override {
+        uint16_t handle = desc->conn_handle;
+        bleConnHandle = handle;
+        bleConnected = true;
+
+        // Throughput: short interval, data length extension, 2M PHY, then pairing
+        server->updateConnParams(handle, BLE_CONN_INTERVAL_MIN, BLE_CONN_INTERVAL_MAX, 0, BLE_CONN_TIMEOUT);
+        ble_hs_hci_util_set_data_len(handle, BLE_DLE_TX_OCTETS, BLE_DLE_TX_TIME);
+        ble_gap_set_prefered_le_phy(handle, BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_2M_MASK,
+                                    BLE_GAP_LE_PHY_CODED_ANY);
+        NimBLEDevice::startSecurity(handle);
+    }
+
+    void onDisconnect(NimBLEServer* server, ble_gap_conn_desc* desc) override {
+        bleConnected = false;
+        bleMtu = 23;
+    }
+
+    void onMTUChange(uint16_t mtu, ble_gap_conn_desc* desc) override {
+        bleMtu = mtu > BLE_PREFERRED_MTU ? BLE_PREFERRED_MTU : mtu;
+    }
+
+    uint32_t onPassKeyRequest() override {
+        return BLE_PASSKEY;
+    }
+};
+
+class BleRxCallbacks : public NimBLECharacteristicCallbacks {
+    // Runs in the NimBLE host task: only split into lines and queue them
+    void onWrite(NimBLECharacteristic* chr) override {
+        std::string value = chr->getValue();
+        char line[BLE_CMD_MAX_LEN];
+        size_t n = 0;
+        for (size_t i = 0; i <= value.size(); i++) {
+            char c = i < value.size() ? value[i] : '\n';
+            if (c == '\n' || c == '\r') {
+                if (n > 0) {
+                    line[n] = '\0';
+                    xQueueSend(bleCmdQueue, line, 0);
+                    n = 0;
+                }
+            } else if (n < BLE_CMD_MAX_LEN - 1) {
+                line[n++] = c;
+            }
+        }
+    }
+};
+
+class BleTxCallbacks : public NimBLECharacteristicCallbacks {
+    void onStatus(NimBLECharacteristic* chr, Status status, int code) override {
+        if (status != SUCCESS_NOTIFY && status != SUCCESS_INDICATE) {
+            bleNotifyErrors++;
+            bleLastErrorMs = millis();
+        }
+    }
+};
+
+// BLE sink: references wait here until the forward task batches them into notifications
+uint8_t bleSinkQueue[SINK_BLE_QUEUE_LEN];
+uint8_t bleSinkHead = 0;
+uint8_t bleSinkCount = 0;
+
+// Batch every queued packet; notifications only go out as batches fill up
+static void bleDrain() {
+    while (bleSinkCount > 0) {
+        uint8_t ref = bleSinkQueue[bleSinkHead];
+        bleSinkHead = (bleSinkHead + 1) % SINK_BLE_QUEUE_LEN;
+        bleSinkCount--;
+        const RxSlot* slot = sinkSlot(ref);
+        if (bleConnected) {
+            bleQueuePacket(slot);
+            sinkDelivered(&bleSink, slot->len, slot->rxMicros);
+        } else {
+            bleSink.lost++;
+        }
+        sinkRelease(ref);
+    }
+}
+
+void bleOffer(Sink* sink, uint8_t ref, uint8_t outputClass) {
+    if (!bleConnected) return;
+    if (outputClass == OUTPUT_CLASS_BULK && bleCongested()) {
+        bleShed++;
+        sink->dropped++;
+        return;
+    }
+    // Batching never waits on the link, so a full queue is simply batched now
+    if (bleSinkCount == SINK_BLE_QUEUE_LEN) bleDrain();
+    sinkRetain(ref);
+    bleSinkQueue[(bleSinkHead + bleSinkCount) % SINK_BLE_QUEUE_LEN] = ref;
+    bleSinkCount++;
+    sink->accepted++;
+}
+
+static void bleNotify(const uint8_t* data, size_t len);
+
+// Decoded images as "IMD" notifications, a few per pass so live packets keep flowing,
+// none while the link is congested. A disconnect starts the image over.
+static void bleImageService() {
+    static bool wasConnected = false;
+    if (bleConnected != wasConnected) {
+        wasConnected = bleConnected;
+        imageChunkRestart(IMAGE_OUTPUT_BLE);
+    }
+    if (!bleConnected) return;
+
+    uint8_t record[BLE_NOTIFY_MAX];
+    memcpy(record, "IMD", 3);
+    size_t limit = bleMtu - 3;
+    if (limit <= 3 + IMAGE_CHUNK_HEADER) return;
+    for (int i = 0; i < IMAGE_BLE_BURST && !bleCongested(); i++) {
+        size_t len = imageChunkPeek(IMAGE_OUTPUT_BLE, record + 3, limit - 3 - IMAGE_CHUNK_HEADER);
+        if (len == 0) return;
+        bleNotify(record, 3 + len);
+        imageChunkSent(IMAGE_OUTPUT_BLE, len);
+    }
+}
+
+// Forward task, RX ring drained: batch what is queued and send the partial notification
+void bleService() {
+    bleDrain();
+    bleFlush();
+    bleImageService();
+}
+
+void initBle() {
+    bleCmdQueue = xQueueCreate(BLE_CMD_QUEUE_LEN, BLE_CMD_MAX_LEN);
+
+    NimBLEDevice::init(BLE_DEVICE_NAME);
+    NimBLEDevice::setMTU(BLE_PREFERRED_MTU);
+    NimBLEDevice::setPower(ESP_PWR_LVL_P9);
+    NimBLEDevice::setSecurityAuth(true, true, true);
+    NimBLEDevice::setSecurityPasskey(BLE_PASSKEY);
+    NimBLEDevice::setSecurityIOCap(BLE_HS_IO_DISPLAY_ONLY);
+
+    bleServer = NimBLEDevice::createServer();
+    bleServer->setCallbacks(new BleServerCallbacks());
+    bleServer->advertiseOnDisconnect(true);
+
+    NimBLEService* service = bleServer->createService(NUS_SERVICE_UUID);
+    bleTxChar = service->createCharacteristic(NUS_TX_UUID, NIMBLE_PROPERTY::NOTIFY, BLE_NOTIFY_MAX);
+    bleTxChar->setCallbacks(new BleTxCallbacks());
+    NimBLECharacteristic* rxChar = service->createCharacteristic(
+        NUS_RX_UUID, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR);
+    rxChar->setCallbacks(new BleRxCallbacks());
+    service->start();
+
+    NimBLEAdvertising* adv = NimBLEDevice::getAdvertising();
+    adv->addServiceUUID(NUS_SERVICE_UUID);
+    adv->setScanResponse(true);
+    adv->start();
+
+    sinkRegister(&bleSink, "BLE", nullptr, nullptr);
+    logPrintf("[BLE] Advertising as " BLE_DEVICE_NAME "\n");
+}
+
+// A notify failed recently (host out of mbufs or the link is saturated)
+bool bleCongested() {
+    return bleNotifyErrors > 0 && millis() - bleLastErrorMs < BLE_CONGESTION_HOLD_MS;
+}
+
+bool bleReceiveCommand(char* line) {
+    return bleCmdQueue != nullptr && xQueueReceive(bleCmdQueue, line, 0) == pdTRUE;
+}
+
+static void bleNotify(const uint8_t* data, size_t len) {
+    bleTxChar->notify(data, len);
+    bleNotifications++;
+}
+
+// A reply longer than one notification goes out in pieces; the app splits lines on '\n'
+void bleSendText(const char* text, size_t len) {
+    if (!bleConnected) return;
+    size_t limit = bleMtu - 3;
+    for (size_t off = 0; off < len; off += limit) {
+        bleNotify((const uint8_t*)text + off, len - off < limit ? len - off : limit);
+    }
+}
+
+// Split one "PKT" record across notifications; only used when it cannot fit the MTU
+static void bleSendChunked(const RxSlot* slot, size_t limit) {
+    uint8_t record[3 + 8 + MAX_PACKET_SIZE];
+    memcpy(record, "PKT", 3);
+    memcpy(record + 3, &slot->rssi, 4);
+    memcpy(record + 7, &slot->snr, 4);
+    memcpy(record + 11, slot->data, slot->len);
+    size_t recordLen = 11 + slot->len;
+
+    size_t perChunk = limit - BLE_CHUNK_HEADER;
+    uint8_t total = (recordLen + perChunk - 1) / perChunk;
+    uint8_t chunk[BLE_NOTIFY_MAX];
+    memcpy(chunk, "CHK", 3);
+    chunk[4] = total;
+    for (uint8_t i = 0; i < total; i++) {
+        size_t offset = i * perChunk;
+        size_t n = recordLen - offset < perChunk ? recordLen - offset : perChunk;
+        chunk[3] = i;
+        memcpy(chunk + BLE_CHUNK_HEADER, record + offset, n);
+        bleNotify(chunk, BLE_CHUNK_HEADER + n);
+    }
+}
+
+// Forward task: append a packet to the pending notification, flushing first if it would overflow
+void bleQueuePacket(const RxSlot* slot) {
+    if (!bleConnected) return;
+
+    size_t limit = bleMtu - 3;
+    if (11 + (size_t)slot->len > limit) {
+        bleFlush();
+        bleSendChunked(slot, limit);
+        blePacketsSent++;
+        return;
+    }
+
+    size_t recordLen = BLE_RECORD_OVERHEAD + slot->len;
+    if (bleBatchCount > 0 &&
+        (BLE_BATCH_HEADER + bleBatchLen + recordLen > limit || bleBatchCount == 255)) {
+        bleFlush();
+    }
+
+    uint8_t* p = bleBatch + BLE_BATCH_HEADER + bleBatchLen;
+    p[0] = slot->len;
+    memcpy(p + 1, &slot->rssi, 4);
+    memcpy(p + 5, &slot->snr, 4);
+    memcpy(p + 9, slot->data, slot->len);
+    bleBatchLen += recordLen;
+    bleBatchCount++;
+    blePacketsSent++;
+}
+
+void bleFlush() {
+    if (bleBatchCount == 0) return;
+
+    // A batch pending when the link dropped is simply discarded
+    if (bleConnected) {
+        if (bleBatchCount == 1) {
+            // Lone packet goes out in the plain "PKT" layout, which drops the LEN byte
+            memcpy(bleBatch + 2, "PKT", 3);
+            bleNotify(bleBatch + 2, bleBatchLen + 2);
+        } else {
+            memcpy(bleBatch, "PKB", 3);
+            bleBatch[3] = bleBatchCount;
+            bleNotify(bleBatch, BLE_BATCH_HEADER + bleBatchLen);
+        }
+    }
+
+    bleBatchLen = 0;
+    bleBatchCount = 0;
+}
+#else
+void initBle() {}
+void bleService() {}
+bool bleCongested() { return false; }
+bool bleReceiveCommand(char* line) { return false; }
+void bleSendText(const char* text, size_t len) {}
+#endif
@@ -2,11 +2,11 @@
  * RaptorHab Ground Station Bridge
  * Heltec Vision Master T190 (ESP32-S3 + SX1262)
  *
- * Receives packets via SX1262 and forwards them over USB serial only
+ * Receives packets via SX1262 and forwards them over USB serial and BLE (NUS)
  * Displays RSSI, SNR, radio settings on 1.9" TFT LCD
  *
  * CONFIGURATION MODE:
- *   On boot, modem waits for configuration from Mac app via USB
+ *   On boot, modem waits for configuration from the app via USB or BLE
  *   Config command: CFG:<freq>,<bitrate>,<deviation>,<bandwidth>,<preamble>\n
  *   Example: CFG:915.0,96.0,50.0,467.0,32\n
  *   Response: CFG_OK:<params>\n or CFG_ERR:<message>\n
@@ -14,103 +14,41 @@
  * Serial Protocol (USB):
  *   [0x7E][LEN_HI][LEN_LO][RSSI_INT][RSSI_FRAC][SNR_INT][SNR_FRAC][DATA...][CHECKSUM][0x7E]
  *
+ *   Frame v2 (opt-in with FMT:2\n, back to v1 with FMT:1\n):
+ *   [0x7E][0xA2][LEN:2][SEQ:4][RX_US:8][RSSI_CDB:2][SNR_CDB:2][DATA...][CRC16:2][0x7E]
+ *   Multi-byte fields big-endian, RSSI/SNR in signed 0.01 dB (0x8000 = none, SNR in GFSK),
+ *   CRC16-CCITT over tag..data, same byte stuffing as v1
+ *
+ * BLE Protocol (Nordic UART Service, notifications on TX characteristic):
+ *   Single packet: ["PKT"][RSSI f32][SNR f32][DATA...]
+ *   Batched:       ["PKB"][COUNT] then COUNT x [LEN][RSSI f32][SNR f32][DATA...]
+ *   Chunked:       ["CHK"][CHUNK#][TOTAL][DATA...] (chunks concatenate to one "PKT")
+ *   Floats are little-endian; text replies (CFG_OK etc.) are sent untagged
+ *
+ *   With -DUSB_VENDOR_LINK=1 (OTG build) the same frames go to a vendor-class
+ *   bulk interface once the host opens it; the CDC port keeps commands and logs
+ *
+ * RX Pipeline:
+ *   - DIO1 ISR notifies a high-priority radio task (RADIO_TASK_CORE)
+ *   - Radio task drains the SX1262 into a lock-free SPSC ring and re-arms RX
+ *   - Forward task (FORWARD_TASK_CORE) validates ring slots and writes frames
+ *
  * TFT Display:
  *   - Shows RSSI, SNR, packet counts, and radio settings
- *   - Updates only during idle periods (no packets for >750ms)
+ *   - Rendered into a PSRAM framebuffer by a low-priority task on the
+ *     non-radio core; only dirty rows are pushed to the ST7789
  */
 
-#include <Arduino.h>
+#include "modem.h"
 #include <SPI.h>
+#include <esp_rom_crc.h>
 #include <RadioLib.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_ST7789.h>
-
-// ============================================================================
-// Configuration
-// ============================================================================
-
-#define DEBUG_OUTPUT        false
-
-// Pin Definitions - Heltec Vision Master T190 LoRa
-#define LORA_NSS    8
-#define LORA_SCK    9
-#define LORA_MOSI   10
-#define LORA_MISO   11
-#define LORA_RST    12
-#define LORA_BUSY   13
-#define LORA_DIO1   14
-#define USER_BUTTON 21
-
-// Pin Definitions - Battery Monitoring
-#define ADC_CTRL_PIN    46      // Controls P-FET switch for battery divider
-#define VBAT_READ_PIN   6       // ADC input from voltage divider
-
-// Battery voltage divider: R9=390K, R11=100K -> ratio = 100/(390+100) = 0.204
-#define VBAT_DIVIDER_RATIO  4.9f    // Multiply ADC voltage by this to get VBAT
-#define VBAT_MIN            3.0f    // Empty LiPo
-#define VBAT_MAX            4.2f    // Full LiPo
-
-// Pin Definitions - TFT Display (ST7789V3)
-#define TFT_CS      39
-#define TFT_RST     40
-#define TFT_DC      47
-#define TFT_SCLK    38
-#define TFT_MOSI    48
-#define TFT_LED_EN  17
-#define TFT_PWR     7
-
-// Display dimensions (landscape orientation)
-#define TFT_WIDTH   320
-#define TFT_HEIGHT  170
-
-// Default RF Configuration
-#define DEFAULT_FREQUENCY       915.0
-#define DEFAULT_BITRATE         96.0
-#define DEFAULT_DEVIATION       50.0
-#define DEFAULT_RX_BANDWIDTH    467.0
-#define DEFAULT_PREAMBLE_LEN    32
-#define RF_DATA_SHAPING         0.5
-
-// Configuration timeout
-#define CONFIG_TIMEOUT_MS       120000    // 2 minutes
-
-// Display update configuration
-#define DISPLAY_IDLE_THRESHOLD_MS   750
-#define DISPLAY_UPDATE_INTERVAL_MS  500
-#define DISPLAY_STATS_INTERVAL_MS   1000
-
-// Sync word "RAPT"
-const uint8_t SYNC_WORD[] = {0x52, 0x41, 0x50, 0x54};
-#define SYNC_WORD_LEN       4
-
-// Serial Protocol
-#define FRAME_DELIMITER     0x7E
-#define SERIAL_BAUD         921600
-#define MAX_PACKET_SIZE     255
-
-// Colors for display
-#define COLOR_BG            ST77XX_BLACK
-#define COLOR_HEADER        0x001F   // Dark blue
-#define COLOR_TEXT          ST77XX_WHITE
-#define COLOR_LABEL         0x8410   // Gray
-#define COLOR_VALUE         ST77XX_CYAN
-#define COLOR_GOOD          ST77XX_GREEN
-#define COLOR_WARN          ST77XX_YELLOW
-#define COLOR_BAD           ST77XX_RED
-#define COLOR_ACCENT        0x07FF   // Cyan
-
-// ============================================================================
-// Debug macros
-// ============================================================================
-
-#if DEBUG_OUTPUT
-  #define DBG(x) Serial.print(x)
-  #define DBGLN(x) Serial.println(x)
-  #define DBGF(...) Serial.printf(__VA_ARGS__)
-#else
-  #define DBG(x)
-  #define DBGLN(x)
-  #define DBGF(...)
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#if ENABLE_BENCHMARKS
+#include "raptor_bench.h"
 #endif
 
 // ============================================================================
@@ -124,6 +62,18 @@ float rfRxBandwidth = DEFAULT_RX_BANDWIDTH;
 uint16_t rfPreambleLen = DEFAULT_PREAMBLE_LEN;
 
 bool configured = false;
+const char* configSource = "DEF";   // Transport the active CFG: arrived on
+
+// Runtime CFG: loop() parses it, the radio task (sole SX1262 user once RX runs) applies it
+RfConfig pendingRfConfig;
+volatile bool radioReconfigPending = false;
+volatile int radioReconfigResult = 0;
+volatile uint8_t radioRetuneChanged = 0;    // RETUNE_* bits touched by the last runtime CFG
+volatile uint32_t radioRetuneBlindUs = 0;   // RX downtime of the last runtime CFG
+TaskHandle_t radioReconfigRequester = nullptr;
+
+// Host frame format (1 = legacy XOR frame, 2 = v2 with sequence/timestamp/CRC16)
+volatile uint8_t hostFrameFormat = 1;
 
 // ============================================================================
 // Global Objects - Radio & Display
@@ -133,61 +83,297 @@ SPIClass* spi = nullptr;
 SX1262* radio = nullptr;
 SPIClass* tftSpi = nullptr;
 Adafruit_ST7789* tft = nullptr;
+Adafruit_GFX* gfx = nullptr;        // Draw target: framebuffer, or the panel itself without PSRAM
+
+TaskHandle_t radioTaskHandle = nullptr;
+TaskHandle_t forwardTaskHandle = nullptr;
+TaskHandle_t displayTaskHandle = nullptr;
+TaskHandle_t batteryTaskHandle = nullptr;
+SemaphoreHandle_t serialMutex = nullptr;
 
-volatile bool packetReceived = false;
 uint32_t packetsTotal = 0;
 uint32_t packetsForwarded = 0;
 uint32_t packetsRejectedNoRapt = 0;
 uint32_t packetsRejectedCrc = 0;
 uint32_t packetsRadioError = 0;
-uint32_t packetsSmall = 0;
-uint32_t packetsLarge = 0;
+uint32_t packetsTelemetry = 0;
+uint32_t packetsImage = 0;
+uint32_t packetsRingOverflow = 0;
+uint32_t packetsFifoOverrun = 0;        // Continuous RX: overwritten in the FIFO by the next packet before the read
+uint32_t packetsRxFollow = 0;           // Continuous RX: ended before the previous one was cleared, read without a DIO1 edge
+uint32_t packetsRxSpurious = 0;         // Woken with RX-done not set: nothing read
+uint32_t packetsDuplicate = 0;
+
+// Frequency trim: loop() stores the offset, then raises afcRetunePending (release); the radio task applies it
+std::atomic<int32_t> afcOffsetHz(0);        // loop(): trim from rfFrequency asked for with AFC:
+std::atomic<bool> afcRetunePending(false);
+std::atomic<int32_t> afcAppliedHz(0);       // Radio task: trim the SX1262 is on
+uint32_t afcRetunes = 0;                    // Radio task
+uint32_t afcGapWaits = 0;                   // Radio task: retunes held for a packet in flight
+
+// Acquisition scan: loop() stores the grid, then raises scanStartPending (release); the radio task runs it
+std::atomic<uint16_t> scanSpanKhz(SCAN_DEFAULT_SPAN_KHZ);
+std::atomic<uint16_t> scanStepKhz(SCAN_DEFAULT_STEP_KHZ);
+std::atomic<uint16_t> scanDwellMs(SCAN_DEFAULT_DWELL_MS);
+std::atomic<uint8_t> scanPresetMask(SCAN_DEFAULT_PRESETS);
+std::atomic<bool> scanStartPending(false);
+std::atomic<bool> scanStopPending(false);
+std::atomic<bool> scanActive(false);        // Radio task
+std::atomic<int64_t> scanPointSince(0);     // Radio task: when the current grid point was tuned
+std::atomic<uint32_t> scanPackets(0);       // Forward task: CRC-valid packets heard while scanning
+std::atomic<bool> scanResultReady(false);   // Radio task hands scanResult to loop() (release)
+
+// Injector: settings written by loop(), applied by the radio task on injectUpdatePending
+volatile uint32_t injectRate = 0;       // Packets/s, 0 = off
+volatile uint8_t injectMinLen = INJECT_DEFAULT_MIN_LEN;
+volatile uint8_t injectMaxLen = INJECT_DEFAULT_MAX_LEN;
+volatile bool injectRadioOff = false;   // Put the SX1262 in standby while injecting
+volatile bool injectUpdatePending = false;
+uint32_t injectGenerated = 0;           // Published into the RX ring
+uint32_t injectDropped = 0;             // Due while the RX ring was full
+uint32_t injectForwarded = 0;           // Passed validation and dedup, handed to the outputs
+
+volatile int64_t dio1Micros = 0;    // Stamped in onPacketReceived()
+volatile bool dio1Pending = false;  // RX-done not yet serviced by the radio task
+volatile uint32_t radioBlindUs = 0; // Running total of retunes, restarts and single-mode re-arms (wraps)
+int rxFollowTaken = -1;              // Radio task: FIFO pointer of a packet read as a follow-up, -1 = none
+int64_t rxFollowMicros = 0;          // When it was found; its own DIO1 edge can only be earlier
 float lastRssi = -120.0;
-float lastSnr = 0.0;
+float lastSnr = NAN;                // NaN: no SNR (GFSK), kept out of the aggregates
 
-// Battery monitoring
-float batteryVoltage = 0.0;
-int batteryPercent = 0;
+// Battery monitoring (published by batteryTask, everyone else only reads)
+volatile float batteryVoltage = 0.0;
+volatile int batteryPercent = 0;
+volatile uint16_t batteryRawMillivolts = 0;     // Last single ADC reading at the pin
 float prevBatteryVoltage = -1.0;
 
-uint32_t lastStatsTime = 0;
-uint32_t lastPacketTime = 0;
-uint32_t lastDisplayUpdate = 0;
-uint32_t lastStatsDisplayUpdate = 0;
+volatile uint32_t statsIntervalMs = STATS_DEFAULT_INTERVAL_MS;   // 0 = no periodic report
+volatile uint8_t statsFormat = STATS_FORMAT_TEXT;
+uint32_t statsFramesSkipped = 0;        // Binary reports not sent because USB had no room
+
+// Report window: maxima since the last report, raised by the owning task, reset by statsWindowTake()
+volatile uint8_t rxRingHighWater = 0;   // Radio task
+volatile uint8_t outputHighWater = 0;   // Forward task
+volatile uint32_t replayHighWater = 0;  // Forward task
+uint32_t loopMaxUs = 0;                 // loop()
+
+// Link quality from the header sequence, written by the forward task only
+LqStats linkQuality;
+volatile bool lqResetPending = false;
+
+// RSSI/SNR range since the last report, radio task only; loop() asks for a restart
+volatile bool signalWindowReset = true;
+uint32_t signalCount = 0;
+uint32_t snrCount = 0;               // Packets of those that had an SNR
+float rssiMin, rssiMax, rssiSum;
+float snrMin, snrMax, snrSum;
+volatile uint32_t lastPacketTime = 0;
+
+// Power save: mode written by loop(), read by the tasks
+volatile bool powerSaveEnabled = false;
+volatile bool powerDfs = false;         // esp_pm accepted frequency scaling (core built with CONFIG_PM_ENABLE)
+volatile bool powerLightSleep = false;  // esp_pm accepted automatic light sleep (core built with tickless idle)
+volatile bool powerUsbHold = false;     // loop(): light sleep held off for an attached USB host
+volatile uint32_t powerActivityMs = 0;  // Last host command or button press
+volatile bool backlightOn = true;       // Display task
+volatile bool latRxToForwardResetPending = false;   // Forward task restarts RX>FWD for a new mode
+uint32_t powerLostEdges = 0;            // RX-done found by the radio task's DIO1 poll
 bool displayNeedsFullRedraw = true;
 
 float prevRssi = -999;
 float prevSnr = -999;
+float prevAfcHz = 0;
+bool prevAfcShown = false;
+bool prevBleConnected = true;
+uint16_t prevBleMtu = 0;
 uint32_t prevPacketsForwarded = 0;
 uint32_t prevPacketsTotal = 0;
+uint32_t prevQualitySecond = UINT32_MAX;
+
+// ============================================================================
+// RX Ring (single producer: radio task, single consumer: forward task)
+// ============================================================================
+
+// RxSlot (one packet as it moves through the pipeline) is in raptor_frame.h
+RxSlot rxRing[RX_RING_SLOTS];
+std::atomic<uint32_t> rxRingHead(0);    // Free-running, written by radio task only
+std::atomic<uint32_t> rxRingTail(0);    // Free-running, written by forward task only
+
+// Producer side: returns the next free slot, or nullptr if the ring is full
+RxSlot* rxRingAcquire() {
+    uint32_t head = rxRingHead.load(std::memory_order_relaxed);
+    uint32_t tail = rxRingTail.load(std::memory_order_acquire);
+    if (head - tail >= RX_RING_SLOTS) return nullptr;
+    return &rxRing[head & (RX_RING_SLOTS - 1)];
+}
+
+void rxRingPublish() {
+    uint32_t head = rxRingHead.load(std::memory_order_relaxed) + 1;
+    rxRingHead.store(head, std::memory_order_release);
+    uint32_t depth = head - rxRingTail.load(std::memory_order_relaxed);
+    if (depth > rxRingHighWater) rxRingHighWater = depth;
+}
+
+// Consumer side: returns the oldest filled slot, or nullptr if the ring is empty
+RxSlot* rxRingPeek() {
+    uint32_t tail = rxRingTail.load(std::memory_order_relaxed);
+    uint32_t head = rxRingHead.load(std::memory_order_acquire);
+    if (head == tail) return nullptr;
+    return &rxRing[tail & (RX_RING_SLOTS - 1)];
+}
+
+void rxRingRelease() {
+    rxRingTail.store(rxRingTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
 
 // ============================================================================
 // CRC32 (IEEE 802.3 polynomial)
 // ============================================================================
 
-uint32_t crc32(const uint8_t* data, size_t len) {
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (int j = 0; j < 8; j++) {
-            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+// Set by crc32SelfTest() if the selected engine disagrees with the reference
+bool crc32UseBitwise = false;
+
+// Reference and slice8 implementations are in raptor_crc.cpp
+void crc32Init() {
+#if CRC32_ENGINE == CRC32_ENGINE_SLICE8
+    crc32Slice8Init();
+#endif
+}
+
+uint32_t IRAM_ATTR crc32(const uint8_t* data, size_t len) {
+    if (crc32UseBitwise) return crc32Bitwise(data, len);
+#if CRC32_ENGINE == CRC32_ENGINE_ROM
+    // ROM routine handles the pre/post inversion itself; seed 0 gives IEEE 802.3
+    return esp_rom_crc32_le(0, data, len);
+#elif CRC32_ENGINE == CRC32_ENGINE_SLICE8
+    return crc32Slice8(data, len);
+#else
+    return crc32Bitwise(data, len);
+#endif
+}
+
+// Check the selected engine against the bitwise reference; falls back on mismatch
+bool crc32SelfTest() {
+    static const uint8_t check[] = "123456789";
+    bool ok = crc32(check, 9) == 0xCBF43926;
+
+    // Every packet length at several alignments, pseudo-random content
+    uint8_t buf[MAX_PACKET_SIZE + 8];
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        x = x * 1664525 + 1013904223;
+        buf[i] = x >> 24;
+    }
+    for (size_t offset = 0; ok && offset < 4; offset++) {
+        for (size_t len = 0; len <= MAX_PACKET_SIZE; len++) {
+            if (crc32(buf + offset, len) != crc32Bitwise(buf + offset, len)) {
+                ok = false;
+                break;
+            }
         }
     }
-    return ~crc;
+
+    if (!ok) crc32UseBitwise = true;
+    return ok;
+}
+
+// ============================================================================
+// Latency Histograms (log2 buckets, microseconds)
+// ============================================================================
+
+// Each histogram has a single writer task; readers tolerate a torn sample
+LatencyHistogram latIsrToRead   = {"ISR>RD", {0}, 0, 0, 0, 0, false};   // DIO1 edge -> radio task starts reading
+LatencyHistogram latReadToRearm = {"RD>RX", {0}, 0, 0, 0, 0, false};    // Read start -> DIO1 re-armed (single mode, with ISR>RD: deaf time)
+LatencyHistogram latValidate    = {"VAL", {0}, 0, 0, 0, 0, false};      // Sync word + CRC32 check
+LatencyHistogram latUsbWrite    = {"USB", {0}, 0, 0, 0, 0, false};      // Frame build + Serial.write()
+LatencyHistogram latEndToEnd    = {"E2E", {0}, 0, 0, 0, 0, false};      // DIO1 edge -> last frame byte handed to USB
+LatencyHistogram latRxToForward = {"RX>FWD", {0}, 0, 0, 0, 0, false};   // DIO1 edge -> forward task picks the packet up
+
+LatencyHistogram* const latencyHistograms[] = {
+    &latIsrToRead, &latReadToRearm, &latValidate, &latUsbWrite, &latEndToEnd, &latRxToForward
+};
+#define LATENCY_HISTOGRAM_COUNT (sizeof(latencyHistograms) / sizeof(latencyHistograms[0]))
+
+// Upper edge (us) of the bucket containing the given percentile; maxUs stands in for the open last bucket
+static uint32_t bucketPercentile(const uint32_t* buckets, uint32_t count, uint32_t maxUs, uint32_t percent) {
+    if (count == 0) return 0;
+    uint32_t target = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) return i == LATENCY_BUCKETS - 1 ? maxUs : (2u << i);
+    }
+    return maxUs;
+}
+
+uint32_t latencyPercentile(const LatencyHistogram* h, uint32_t percent) {
+    return bucketPercentile(h->buckets, h->count, h->maxUs, percent);
+}
+
+static void latencyClear(LatencyHistogram* h) {
+    memset(h->buckets, 0, sizeof(h->buckets));
+    h->count = 0;
+    h->maxUs = 0;
+    h->totalUs = 0;
+    h->windowMaxUs = 0;
+}
+
+void latencyReset() {
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_COUNT; i++) {
+        latencyClear(latencyHistograms[i]);
+    }
+}
+
+// Radio task: fold one packet into the RSSI/SNR range of the current report; a NaN SNR is skipped
+static inline void signalRecord(float rssi, float snr) {
+    if (signalWindowReset) {
+        signalWindowReset = false;
+        signalCount = 0;
+        snrCount = 0;
+    }
+    if (signalCount == 0) {
+        rssiMin = rssiMax = rssiSum = rssi;
+    } else {
+        if (rssi < rssiMin) rssiMin = rssi;
+        if (rssi > rssiMax) rssiMax = rssi;
+        rssiSum += rssi;
+    }
+    signalCount++;
+    if (isnan(snr)) return;
+    if (snrCount == 0) {
+        snrMin = snrMax = snrSum = snr;
+    } else {
+        if (snr < snrMin) snrMin = snr;
+        if (snr > snrMax) snrMax = snr;
+        snrSum += snr;
+    }
+    snrCount++;
 }
 
 // ============================================================================
 // Forward Declarations
 // ============================================================================
 
-bool parseConfigCommand(const String& cmd);
+bool parseConfigCommand(const char* cmd, RfConfig* cfg);
+bool validateRfConfig(const RfConfig& cfg);
+bool loadSavedConfig();
+void saveRfConfig();
+void forgetSavedConfig();
+void handleHostCommand(const char* cmd);
+bool handleConfigLine(const char* line, const char* source);
+bool pollHostCommands();
 
 // ============================================================================
 // Interrupt Handler
 // ============================================================================
 
 void IRAM_ATTR onPacketReceived() {
-    packetReceived = true;
+    dio1Micros = esp_timer_get_time();
+    dio1Pending = true;
+    if (radioTaskHandle == nullptr) return;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(radioTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
 }
 
 // ============================================================================
@@ -195,20 +381,585 @@ void IRAM_ATTR onPacketReceived() {
 // ============================================================================
 
 void handlePacket();
-void forwardPacket(uint8_t* data, int len, float rssi, float snr);
+void processPacket(const RxSlot* slot);
+void radioTask(void* param);
+void forwardTask(void* param);
+bool startPipeline();
 void sendStats();
+void statsRearm();
+void reportStats(uint8_t format);
+void handleStatsCommand(const char* arg);
+void sendLatencyReport();
+void sendLatencyFrame();
+void runBenchmarks();
+TickType_t injectService();
+void afcRequest();
+TickType_t afcService();
+void afcRadioRetuned();
+void initAfc();
+void handleAfcCommand(const char* arg);
+void sendAfcStatus();
+void scanRecord(const RxSlot* slot);
+TickType_t scanService();
+void scanAbort();
+void scanReport();
+void handleScanCommand(const char* args);
+void sendScanStatus();
+void handleLqCommand(const char* arg);
+void sendLqStatus();
+void initLoopScheduler();
+void sendSchedStatus();
+void handleInjectCommand(const char* args);
+void sendInjectStatus();
 bool waitForConfiguration();
 bool initializeRadio();
+bool startRadio();
+int configureRadio();
+void applyPendingRadioConfig();
+int requestRadioReconfig(const RfConfig& cfg);
 void initDisplay();
+void displayFlush();
+void displayTask(void* param);
 void drawStaticUI();
 void updateDisplay();
 void updateSignalDisplay();
+void updateLinkDisplay();
 void updateStatsDisplay();
+void updateQualityDisplay();
 void updateBatteryDisplay();
-float readBatteryVoltage();
+uint32_t readBatteryMillivolts();
+void batteryTask(void* param);
+void sendBatteryStatus();
+void initPower();
+void powerUsbUpdate();
+bool powerCheckLostEdge();
+void powerUpdateBacklight();
+void handlePowerCommand(const char* arg);
+void sendPowerStatus();
 void showWaitingScreen();
 void showConfiguredScreen();
 
+// ============================================================================
+// RaptorQ Symbol Accounting (type 0x01 metadata / 0x02 image data)
+// ============================================================================
+
+static inline uint16_t readBe16(const uint8_t* p) {
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static inline uint32_t readBe32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+struct ImageTrack {
+    bool active;
+    bool readyReported;
+    uint16_t imageId;
+    uint16_t sourceSymbols;     // K from the 0x01 metadata packet, 0 until seen
+    uint16_t symbolSize;
+    uint32_t totalSize;
+    uint32_t received;          // Unique symbols, symbol_ids below IMAGE_MAX_SYMBOLS only
+    uint32_t duplicates;        // Repeated symbol_ids, dedup's drops included
+    uint32_t lastSeenMs;
+    uint8_t* bitmap;            // IMAGE_MAX_SYMBOLS bits, one per symbol_id
+    uint8_t* image;             // Reconstruction buffer, nullptr if the image is not being rebuilt
+    uint16_t imageSymbolSize;   // Symbol bytes seen in the first stored 0x02 packet
+    uint16_t sourceHeld;        // Source symbols (ESI < K) in image, counted once K is known
+    bool decoded;
+    bool failReported;          // IMG_FAIL sent: the modem will not deliver this image
+    uint8_t sendPending;        // IMAGE_OUTPUT_* bits still to be sent the decoded image
+    uint32_t imageCrc;          // CRC32 of the decoded image
+    uint32_t metaCrc;           // crc32 from the 0x01 metadata, valid if metaCrcKnown
+    bool metaCrcKnown;
+};
+
+// Owned by the forward task; the IMG? query only reads
+ImageTrack imageTracks[IMAGE_TRACK_SLOTS];
+volatile bool imageTrackingEnabled = true;
+
+// Reconstruction: IMG:OUT: sets imageOutputs, the forward task does the rest
+uint8_t* imageReconPool = nullptr;          // IMAGE_RECON_SLOTS x IMAGE_RECON_MAX_BYTES in PSRAM
+std::atomic<uint8_t> imageOutputs(0);       // IMAGE_OUTPUT_* bits of outputs that take decoded images
+std::atomic<int32_t> imageResendId(-1);     // IMG:SEND: asks for an image again, taken by the forward task
+uint32_t imagesDecoded = 0;
+uint32_t imagesFailed = 0;
+uint32_t imagesSent[IMAGE_OUTPUTS];
+
+struct ImageSend {
+    ImageTrack* track;          // Image being sent, nullptr between images
+    uint32_t offset;            // Next byte
+};
+ImageSend imageSends[IMAGE_OUTPUTS];
+
+bool initImageTracking() {
+    size_t bytes = IMAGE_TRACK_SLOTS * (IMAGE_MAX_SYMBOLS / 8);
+    uint8_t* pool = (uint8_t*)ps_malloc(bytes);
+    if (pool == nullptr) pool = (uint8_t*)malloc(bytes);
+    if (pool == nullptr) {
+        imageTrackingEnabled = false;
+        return false;
+    }
+
+    for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+        memset(&imageTracks[i], 0, sizeof(ImageTrack));
+        imageTracks[i].bitmap = pool + i * (IMAGE_MAX_SYMBOLS / 8);
+    }
+
+    // Too big for internal RAM; without PSRAM images are only accounted, not rebuilt
+    imageReconPool = (uint8_t*)ps_malloc((size_t)IMAGE_RECON_SLOTS * IMAGE_RECON_MAX_BYTES);
+    return true;
+}
+
+// An image some output wanted rebuilt won't be: say so, once. The raw symbols
+// went to every link, so the host still has what it needs to decode it.
+static void imageReportFailed(ImageTrack* t, const char* reason) {
+    if (t->decoded || t->failReported || imageOutputs.load(std::memory_order_relaxed) == 0) return;
+    t->failReported = true;
+    imagesFailed++;
+    hostPrintf("IMG_FAIL:id=%u src=%u/%u rx=%lu %s\n",
+               t->imageId, t->sourceHeld, t->sourceSymbols, t->received, reason);
+}
+
+// Eviction order of a buffer's owner: 0 = decoded and sent, or already failed; 1 = still being rebuilt
+static inline int imageReconRank(const ImageTrack* t) {
+    return t->failReported || t->decoded ? 0 : 1;
+}
+
+// A free reconstruction buffer, else one taken from an image that isn't being sent: a finished
+// or failed one first, the least recently seen within that. An image still being rebuilt that
+// loses its buffer gets IMG_FAIL "busy".
+static uint8_t* imageReconAcquire() {
+    if (imageReconPool == nullptr || imageOutputs.load(std::memory_order_relaxed) == 0) return nullptr;
+    ImageTrack* victim = nullptr;
+    for (int b = 0; b < IMAGE_RECON_SLOTS; b++) {
+        uint8_t* buffer = imageReconPool + (size_t)b * IMAGE_RECON_MAX_BYTES;
+        ImageTrack* owner = nullptr;
+        for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+            if (imageTracks[i].active && imageTracks[i].image == buffer) owner = &imageTracks[i];
+        }
+        if (owner == nullptr) return buffer;
+        if (owner->sendPending != 0) continue;
+        int rank = imageReconRank(owner);
+        if (victim == nullptr || rank < imageReconRank(victim) ||
+            (rank == imageReconRank(victim) && (int32_t)(owner->lastSeenMs - victim->lastSeenMs) < 0)) {
+            victim = owner;
+        }
+    }
+    if (victim == nullptr) return nullptr;
+    imageReportFailed(victim, "busy");
+    uint8_t* buffer = victim->image;
+    victim->image = nullptr;
+    return buffer;
+}
+
+// Find the slot for an image, recycling the least recently seen one for a new id
+ImageTrack* imageTrackFor(uint16_t imageId) {
+    ImageTrack* oldest = &imageTracks[0];
+    for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+        ImageTrack* t = &imageTracks[i];
+        if (t->active && t->imageId == imageId) return t;
+        if (!t->active) {
+            oldest = t;
+        } else if (oldest->active && (int32_t)(t->lastSeenMs - oldest->lastSeenMs) < 0) {
+            oldest = t;
+        }
+    }
+
+    if (oldest->active) imageReportFailed(oldest, "evicted");
+    for (int o = 0; o < IMAGE_OUTPUTS; o++) {
+        if (imageSends[o].track == oldest) imageSends[o].track = nullptr;
+    }
+    uint8_t* bitmap = oldest->bitmap;
+    memset(oldest, 0, sizeof(ImageTrack));
+    memset(bitmap, 0, IMAGE_MAX_SYMBOLS / 8);
+    oldest->bitmap = bitmap;
+    oldest->active = true;
+    oldest->imageId = imageId;
+    // Only from the first packet on: every symbol marked in the bitmap is then also in the buffer
+    oldest->image = imageReconAcquire();
+    if (oldest->image == nullptr) imageReportFailed(oldest, "busy");
+    return oldest;
+}
+
+void reportImageTrack(const ImageTrack* t) {
+    uint32_t need = t->sourceSymbols ? t->sourceSymbols + IMAGE_DECODE_OVERHEAD : 0;
+    hostPrintf("[IMG] id=%u rx=%lu need=%lu K=%u dup=%lu size=%lu ready=%d src=%u decoded=%d\n",
+               t->imageId, t->received, need, t->sourceSymbols, t->duplicates,
+               t->totalSize, need > 0 && t->received >= need ? 1 : 0, t->sourceHeld, t->decoded ? 1 : 0);
+}
+
+// Systematic fast path, not a RaptorQ decoder. Encoding symbols with ESI 0..K-1
+// are the image itself, in order, the last one zero-padded. Each 0x02 payload
+// carries the encoder's serialized packet, a 4-byte PayloadId (SBN, ESI) and
+// then the symbol. The modem places source symbols at ESI * symbol size and,
+// once all K are there, has the image. A lost source symbol can only be made up
+// from repair symbols by a full RFC 6330 decoder, which stays on the host: raw
+// symbols keep flowing to every link until the image is complete, and an image
+// that never completes gets an IMG_FAIL notice. The metadata CRC32 is checked
+// before delivery, so an encoder whose low ids are not source symbols (the LT
+// fallback) fails the image instead of delivering garbage.
+
+// Stop rebuilding an image whose symbols don't fit the layout above
+static void imageReconDrop(ImageTrack* t) {
+    t->image = nullptr;
+    t->sourceHeld = 0;
+    imageReportFailed(t, "layout");
+}
+
+// Symbols counted in the bitmap below K, for when the metadata arrives after them
+static uint16_t imageCountSource(const ImageTrack* t) {
+    uint16_t held = 0;
+    for (uint32_t id = 0; id < t->sourceSymbols && id < IMAGE_MAX_SYMBOLS; id++) {
+        if (t->bitmap[id >> 3] & (1 << (id & 7))) held++;
+    }
+    return held;
+}
+
+// First metadata for an image being rebuilt: check it against the symbols stored so far
+static void imageReconMeta(ImageTrack* t) {
+    uint32_t span = (uint32_t)t->sourceSymbols * t->symbolSize;
+    if (t->totalSize == 0 || span < t->totalSize || span > IMAGE_RECON_MAX_BYTES ||
+        (t->imageSymbolSize != 0 && t->imageSymbolSize != t->symbolSize)) {
+        imageReconDrop(t);
+        return;
+    }
+    t->sourceHeld = imageCountSource(t);
+}
+
+// New symbol_id: copy a source symbol into place
+static void imageReconStore(ImageTrack* t, uint32_t symbolId, const uint8_t* data, int len) {
+    if (len <= IMAGE_PAYLOAD_ID_SIZE) return;
+    uint32_t esi = ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+    uint16_t size = len - IMAGE_PAYLOAD_ID_SIZE;
+    if (data[0] != 0 || esi != symbolId || (t->imageSymbolSize != 0 && size != t->imageSymbolSize) ||
+        (t->symbolSize != 0 && size != t->symbolSize)) {
+        // A second source block, another numbering or a short symbol: not ours to rebuild
+        imageReconDrop(t);
+        return;
+    }
+    t->imageSymbolSize = size;
+    if (t->sourceSymbols != 0 && esi >= t->sourceSymbols) return;     // Repair symbol
+    if ((esi + 1) * size > IMAGE_RECON_MAX_BYTES) return;              // Before K is known: no room
+    memcpy(t->image + esi * size, data + IMAGE_PAYLOAD_ID_SIZE, size);
+    if (t->sourceSymbols != 0) t->sourceHeld++;
+}
+
+// Every source symbol is in: the image is complete if it matches the metadata CRC32
+static void imageReconComplete(ImageTrack* t) {
+    uint32_t crc = crc32(t->image, t->totalSize);    // A few ms for a large image, once
+    if (t->metaCrcKnown && crc != t->metaCrc) {
+        t->image = nullptr;
+        imageReportFailed(t, "crc");
+        return;
+    }
+    t->decoded = true;
+    t->imageCrc = crc;
+    t->sendPending = imageOutputs.load(std::memory_order_relaxed);
+    imagesDecoded++;
+    reportImageTrack(t);
+}
+
+// Forward task: update accounting for a validated image packet
+void trackImagePacket(const uint8_t* packet, int len) {
+    const uint8_t* payload = packet + PKT_HEADER_SIZE;
+    int payloadLen = len - PKT_HEADER_SIZE - 4;
+    uint8_t type = packet[4];
+    if (payloadLen < (type == PKT_TYPE_IMAGE_META ? 10 : 6)) return;
+
+    ImageTrack* t = imageTrackFor(readBe16(payload));
+    t->lastSeenMs = millis();
+
+    if (type == PKT_TYPE_IMAGE_META) {
+        bool first = t->sourceSymbols == 0;
+        t->totalSize = readBe32(payload + 2);
+        t->symbolSize = readBe16(payload + 6);
+        t->sourceSymbols = readBe16(payload + 8);
+        if (payloadLen >= 14) {
+            t->metaCrc = readBe32(payload + 10);
+            t->metaCrcKnown = true;
+        }
+        if (first && t->image != nullptr) imageReconMeta(t);
+    } else {
+        // Past the bitmap a repeat can't be told from a new symbol, so it isn't counted at all
+        uint32_t symbolId = readBe32(payload + 2);
+        if (symbolId >= IMAGE_MAX_SYMBOLS) return;
+        uint8_t mask = 1 << (symbolId & 7);
+        if (t->bitmap[symbolId >> 3] & mask) {
+            t->duplicates++;
+            return;
+        }
+        t->bitmap[symbolId >> 3] |= mask;
+        if (t->image != nullptr && !t->decoded) imageReconStore(t, symbolId, payload + 6, payloadLen - 6);
+        t->received++;
+    }
+
+    if (t->image != nullptr && !t->decoded && t->sourceSymbols > 0 && t->sourceHeld >= t->sourceSymbols) {
+        imageReconComplete(t);
+    }
+
+    // Tell the host once, as soon as the image can be decoded
+    if (!t->readyReported && t->sourceSymbols > 0 &&
+        t->received >= (uint32_t)t->sourceSymbols + IMAGE_DECODE_OVERHEAD) {
+        t->readyReported = true;
+        reportImageTrack(t);
+    }
+}
+
+// Forward task: the symbol is for an image already rebuilt, so IMAGE-mode sinks can skip it
+bool imageSymbolRedundant(const uint8_t* packet, int len) {
+    if (len < PKT_HEADER_SIZE + 2 + 4) return false;
+    uint16_t imageId = readBe16(packet + PKT_HEADER_SIZE);
+    for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+        const ImageTrack* t = &imageTracks[i];
+        if (t->active && t->imageId == imageId) return t->decoded && t->image != nullptr;
+    }
+    return false;
+}
+
+// Forward task: incomplete images still waited for, so the task wakes to time them out
+bool imageAwaitingSymbols() {
+    if (imageOutputs.load(std::memory_order_relaxed) == 0) return false;
+    for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+        const ImageTrack* t = &imageTracks[i];
+        if (t->active && !t->decoded && !t->failReported) return true;
+    }
+    return false;
+}
+
+// Forward task: IMG:SEND:, outputs switched back to raw, and images that stopped short
+void imageService() {
+    // Taken in one step, so an IMG:SEND: arriving meanwhile is kept for the next pass
+    int32_t resend = imageResendId.exchange(-1, std::memory_order_relaxed);
+    uint8_t outputs = imageOutputs.load(std::memory_order_relaxed);
+    if (resend >= 0) {
+        for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+            ImageTrack* t = &imageTracks[i];
+            if (t->active && t->decoded && t->image != nullptr && t->imageId == resend) {
+                t->sendPending = outputs;
+                for (int o = 0; o < IMAGE_OUTPUTS; o++) {
+                    if (imageSends[o].track == t) imageSends[o].offset = 0;
+                }
+            }
+        }
+    }
+    uint32_t now = millis();
+    for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+        ImageTrack* t = &imageTracks[i];
+        t->sendPending &= outputs;
+        if (t->active && now - t->lastSeenMs >= IMAGE_FAIL_IDLE_MS) imageReportFailed(t, "missing");
+    }
+}
+
+// Forward task: the next chunk of a decoded image for one output, header then at most
+// maxData image bytes, into out[]; returns its length, 0 when nothing is waiting
+size_t imageChunkPeek(uint8_t output, uint8_t* out, size_t maxData) {
+    uint8_t bit = 1 << output;
+    ImageSend* s = &imageSends[output];
+    if (s->track != nullptr && !(s->track->sendPending & bit)) s->track = nullptr;
+    for (int i = 0; i < IMAGE_TRACK_SLOTS && s->track == nullptr; i++) {
+        if (imageTracks[i].sendPending & bit) {
+            s->track = &imageTracks[i];
+            s->offset = 0;
+        }
+    }
+    const ImageTrack* t = s->track;
+    if (t == nullptr) return 0;
+
+    size_t n = t->totalSize - s->offset;
+    if (n > maxData) n = maxData;
+    out[0] = t->imageId >> 8;
+    out[1] = t->imageId & 0xFF;
+    for (int b = 0; b < 4; b++) {
+        out[2 + b] = (t->totalSize >> (24 - 8 * b)) & 0xFF;
+        out[6 + b] = (t->imageCrc >> (24 - 8 * b)) & 0xFF;
+        out[10 + b] = (s->offset >> (24 - 8 * b)) & 0xFF;
+    }
+    memcpy(out + IMAGE_CHUNK_HEADER, t->image + s->offset, n);
+    return IMAGE_CHUNK_HEADER + n;
+}
+
+// The chunk from imageChunkPeek() is on its way
+void imageChunkSent(uint8_t output, size_t len) {
+    ImageSend* s = &imageSends[output];
+    s->offset += len - IMAGE_CHUNK_HEADER;
+    if (s->offset >= s->track->totalSize) {
+        s->track->sendPending &= ~(1 << output);
+        s->track = nullptr;
+        imagesSent[output]++;
+    }
+}
+
+// A link dropped mid-image: start that image over on this output
+void imageChunkRestart(uint8_t output) {
+    imageSends[output].offset = 0;
+}
+
+// ============================================================================
+// Duplicate Suppression
+// ============================================================================
+
+// Key is (type, image_id, symbol_id) for image data, (type, header sequence) otherwise
+struct DedupEntry {
+    uint32_t keyHi;
+    uint32_t keyLo;
+    uint32_t gen;               // Insertion number; 0 = never used
+};
+
+// Owned by the forward task
+DedupEntry dedupTable[DEDUP_TABLE_SIZE];
+uint32_t dedupGen = 0;
+volatile bool dedupEnabled = true;
+
+static inline bool dedupLive(const DedupEntry* e) {
+    return e->gen != 0 && dedupGen - e->gen < DEDUP_WINDOW;
+}
+
+// Returns true if the packet was already forwarded within the window, otherwise remembers it
+bool isDuplicatePacket(const uint8_t* packet, int len) {
+    uint8_t type = packet[4];
+    uint32_t keyHi, keyLo;
+    if (type == PKT_TYPE_IMAGE_DATA && len >= PKT_HEADER_SIZE + 6 + 4) {
+        keyHi = 0x80000000 | ((uint32_t)type << 16) | readBe16(packet + PKT_HEADER_SIZE);
+        keyLo = readBe32(packet + PKT_HEADER_SIZE + 2);
+    } else {
+        keyHi = 0x40000000 | ((uint32_t)type << 16);
+        keyLo = readBe16(packet + 5);
+    }
+
+    // Murmur3 finaliser over both halves
+    uint32_t h = keyHi * 0x9E3779B1 ^ keyLo;
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+
+    // Probe the whole run: with no deletions a live key can sit past an expired slot
+    DedupEntry* victim = nullptr;
+    uint32_t victimAge = 0;
+    for (uint32_t i = 0; i < DEDUP_MAX_PROBE; i++) {
+        DedupEntry* e = &dedupTable[(h + i) & (DEDUP_TABLE_SIZE - 1)];
+        uint32_t age = UINT32_MAX;      // Empty or expired: preferred victim
+        if (dedupLive(e)) {
+            if (e->keyHi == keyHi && e->keyLo == keyLo) return true;
+            age = dedupGen - e->gen;
+        }
+        if (victim == nullptr || age > victimAge) {
+            victim = e;
+            victimAge = age;
+        }
+    }
+
+    // Reuse an expired slot, or evict the oldest key on this probe run
+    if (++dedupGen == 0) dedupGen = 1;
+    victim->keyHi = keyHi;
+    victim->keyLo = keyLo;
+    victim->gen = dedupGen;
+    return false;
+}
+
+// ============================================================================
+// Framebuffer Canvas
+// ============================================================================
+
+// Full-screen RGB565 canvas in PSRAM that records which pixels changed per row
+class FrameCanvas : public Adafruit_GFX {
+public:
+    explicit FrameCanvas(uint16_t* buf) : Adafruit_GFX(TFT_WIDTH, TFT_HEIGHT), buffer(buf) {
+        clearDirty();
+    }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+        if (x < 0 || y < 0 || x >= TFT_WIDTH || y >= TFT_HEIGHT) return;
+        buffer[y * TFT_WIDTH + x] = color;
+        markDirty(x, y, 1, 1);
+    }
+
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+        if (!clip(x, y, w, h)) return;
+        for (int16_t row = y; row < y + h; row++) {
+            uint16_t* p = &buffer[row * TFT_WIDTH + x];
+            for (int16_t i = 0; i < w; i++) p[i] = color;
+        }
+        markDirty(x, y, w, h);
+    }
+
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+        fillRect(x, y, w, 1, color);
+    }
+
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+        fillRect(x, y, 1, h, color);
+    }
+
+    void fillScreen(uint16_t color) override {
+        fillRect(0, 0, TFT_WIDTH, TFT_HEIGHT, color);
+    }
+
+    // Push dirty rows to the panel, merging consecutive rows into one address window
+    void flush(Adafruit_ST7789* panel) {
+        bool started = false;
+        int16_t y = 0;
+        while (y < TFT_HEIGHT) {
+            if (dirtyMaxX[y] < dirtyMinX[y]) {
+                y++;
+                continue;
+            }
+
+            int16_t y0 = y;
+            int16_t x0 = dirtyMinX[y];
+            int16_t x1 = dirtyMaxX[y];
+            while (y + 1 < TFT_HEIGHT && dirtyMaxX[y + 1] >= dirtyMinX[y + 1]) {
+                y++;
+                x0 = min(x0, dirtyMinX[y]);
+                x1 = max(x1, dirtyMaxX[y]);
+            }
+
+            if (!started) {
+                panel->startWrite();
+                started = true;
+            }
+            int16_t w = x1 - x0 + 1;
+            panel->setAddrWindow(x0, y0, w, y - y0 + 1);
+            for (int16_t row = y0; row <= y; row++) {
+                panel->writePixels(&buffer[row * TFT_WIDTH + x0], w);
+            }
+            y++;
+        }
+        if (started) panel->endWrite();
+        clearDirty();
+    }
+
+private:
+    uint16_t* buffer;
+    int16_t dirtyMinX[TFT_HEIGHT];
+    int16_t dirtyMaxX[TFT_HEIGHT];
+
+    bool clip(int16_t& x, int16_t& y, int16_t& w, int16_t& h) {
+        if (x < 0) { w += x; x = 0; }
+        if (y < 0) { h += y; y = 0; }
+        if (x + w > TFT_WIDTH) w = TFT_WIDTH - x;
+        if (y + h > TFT_HEIGHT) h = TFT_HEIGHT - y;
+        return w > 0 && h > 0;
+    }
+
+    void markDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+        for (int16_t row = y; row < y + h; row++) {
+            if (x < dirtyMinX[row]) dirtyMinX[row] = x;
+            if (x + w - 1 > dirtyMaxX[row]) dirtyMaxX[row] = x + w - 1;
+        }
+    }
+
+    void clearDirty() {
+        for (int16_t row = 0; row < TFT_HEIGHT; row++) {
+            dirtyMinX[row] = TFT_WIDTH;
+            dirtyMaxX[row] = -1;
+        }
+    }
+};
+
+FrameCanvas* canvas = nullptr;
+
 // ============================================================================
 // Display Functions
 // ============================================================================
@@ -226,6 +977,17 @@ void initDisplay() {
     tft->init(TFT_HEIGHT, TFT_WIDTH);
     tft->setRotation(1);
     tft->fillScreen(COLOR_BG);
+
+    // Fall back to drawing straight to the panel if PSRAM is unavailable
+    uint16_t* fb = (uint16_t*)ps_malloc(TFT_WIDTH * TFT_HEIGHT * sizeof(uint16_t));
+    if (fb != nullptr) {
+        canvas = new FrameCanvas(fb);
+        canvas->fillScreen(COLOR_BG);
+        gfx = canvas;
+    } else {
+        logPrintf("[TFT] No PSRAM framebuffer - drawing directly\n");
+        gfx = tft;
+    }
     
     pinMode(TFT_LED_EN, OUTPUT);
     digitalWrite(TFT_LED_EN, HIGH);
@@ -233,111 +995,177 @@ void initDisplay() {
     displayNeedsFullRedraw = true;
 }
 
+void displayFlush() {
+    if (canvas) canvas->flush(tft);
+}
+
+// Sole owner of the display once started: render into the framebuffer, then push
+void displayTask(void* param) {
+    for (;;) {
+        powerUpdateBacklight();
+        if (!backlightOn) {
+            // Dark panel: skip rendering and SPI pushes, just watch for activity
+            vTaskDelay(pdMS_TO_TICKS(POWER_DISPLAY_IDLE_MS));
+            continue;
+        }
+        updateDisplay();
+        displayFlush();
+        vTaskDelay(pdMS_TO_TICKS(DISPLAY_UPDATE_INTERVAL_MS));
+    }
+}
+
 void drawStaticUI() {
-    tft->fillScreen(COLOR_BG);
+    gfx->fillScreen(COLOR_BG);
     
     // Header bar
-    tft->fillRect(0, 0, TFT_WIDTH, 24, COLOR_HEADER);
-    tft->setTextColor(COLOR_TEXT);
-    tft->setTextSize(2);
-    tft->setCursor(10, 4);
-    tft->print("RAPTORHAB MODEM");
+    gfx->fillRect(0, 0, TFT_WIDTH, 24, COLOR_HEADER);
+    gfx->setTextColor(COLOR_TEXT);
+    gfx->setTextSize(2);
+    gfx->setCursor(10, 4);
+    gfx->print("RAPTORHAB MODEM");
     
     // Divider line
-    tft->drawFastHLine(0, 25, TFT_WIDTH, COLOR_ACCENT);
+    gfx->drawFastHLine(0, 25, TFT_WIDTH, COLOR_ACCENT);
     
     // Radio Settings Section
-    tft->setTextSize(1);
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(5, 32);
-    tft->print("RADIO SETTINGS");
+    gfx->setTextSize(1);
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(5, 32);
+    gfx->print("RADIO SETTINGS");
     
-    tft->drawFastHLine(0, 42, TFT_WIDTH, 0x4208);
+    gfx->drawFastHLine(0, 42, TFT_WIDTH, 0x4208);
     
     // Settings labels (left column)
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(5, 48);
-    tft->print("FREQ:");
-    tft->setCursor(5, 60);
-    tft->print("BR:");
-    tft->setCursor(5, 72);
-    tft->print("DEV:");
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(5, 48);
+    gfx->print("FREQ:");
+    gfx->setCursor(5, 60);
+    gfx->print("BR:");
+    gfx->setCursor(5, 72);
+    gfx->print("DEV:");
     
     // Settings labels (right column)
-    tft->setCursor(110, 48);
-    tft->print("BW:");
-    tft->setCursor(110, 60);
-    tft->print("PRE:");
-    tft->setCursor(110, 72);
-    tft->print("CFG:");
+    gfx->setCursor(110, 48);
+    gfx->print("BW:");
+    gfx->setCursor(110, 60);
+    gfx->print("PRE:");
+    gfx->setCursor(110, 72);
+    gfx->print("CFG:");
     
     // Settings values (left column)
-    tft->setTextColor(COLOR_VALUE);
-    tft->setCursor(35, 48);
-    tft->printf("%.1f MHz", rfFrequency);
-    tft->setCursor(25, 60);
-    tft->printf("%.0f kbps", rfBitrate);
-    tft->setCursor(30, 72);
-    tft->printf("%.0f kHz", rfDeviation);
+    gfx->setTextColor(COLOR_VALUE);
+    gfx->setCursor(35, 48);
+    gfx->printf("%.1f MHz", rfFrequency);
+    gfx->setCursor(25, 60);
+    gfx->printf("%.0f kbps", rfBitrate);
+    gfx->setCursor(30, 72);
+    gfx->printf("%.0f kHz", rfDeviation);
     
     // Settings values (right column)
-    tft->setCursor(130, 48);
-    tft->printf("%.0f kHz", rfRxBandwidth);
-    tft->setCursor(135, 60);
-    tft->printf("%d bits", rfPreambleLen);
-    tft->setCursor(135, 72);
-    tft->print("USB");
+    gfx->setCursor(130, 48);
+    gfx->printf("%.0f kHz", rfRxBandwidth);
+    gfx->setCursor(135, 60);
+    gfx->printf("%d bits", rfPreambleLen);
+    gfx->setCursor(135, 72);
+    gfx->print(configSource);
 
     // Divider
-    tft->drawFastHLine(0, 85, TFT_WIDTH, 0x4208);
+    gfx->drawFastHLine(0, 85, TFT_WIDTH, 0x4208);
 
     // Signal section header
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(5, 90);
-    tft->print("SIGNAL");
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(5, 90);
+    gfx->print("SIGNAL");
+
+    // Bluetooth section header
+    gfx->setCursor(200, 90);
+    gfx->print("BLUETOOTH");
 
     // Stats section header
-    tft->setCursor(5, 135);
-    tft->print("STATISTICS");
+    gfx->setCursor(5, 135);
+    gfx->print("STATISTICS");
     
     displayNeedsFullRedraw = false;
+    prevRssi = -999;
+    prevBleMtu = 0;
+    prevPacketsTotal = UINT32_MAX;
+    prevQualitySecond = UINT32_MAX;
+    prevBatteryVoltage = -1.0;
 }
 
 void updateSignalDisplay() {
     // Only update if values changed
-    if (lastRssi == prevRssi && lastSnr == prevSnr) {
+    float afcHz = (float)afcAppliedHz.load(std::memory_order_relaxed);
+    bool afcShown = afcOffsetHz.load(std::memory_order_relaxed) != 0 || afcHz != 0.0f;
+    bool snrSame = lastSnr == prevSnr || (isnan(lastSnr) && isnan(prevSnr));
+    if (lastRssi == prevRssi && snrSame && afcShown == prevAfcShown && afcHz == prevAfcHz) {
         return;
     }
 
     // Clear signal value area
-    tft->fillRect(5, 100, 310, 30, COLOR_BG);
+    gfx->fillRect(5, 100, 190, 30, COLOR_BG);
 
     // RSSI
-    tft->setTextSize(2);
+    gfx->setTextSize(2);
     uint16_t rssiColor = lastRssi > -80 ? COLOR_GOOD : (lastRssi > -100 ? COLOR_WARN : COLOR_BAD);
-    tft->setTextColor(rssiColor);
-    tft->setCursor(5, 105);
-    tft->printf("%.0f", lastRssi);
-    tft->setTextSize(1);
-    tft->print(" dBm");
-
-    // SNR
-    tft->setTextSize(2);
-    uint16_t snrColor = lastSnr > 5 ? COLOR_GOOD : (lastSnr > 0 ? COLOR_WARN : COLOR_BAD);
-    tft->setTextColor(snrColor);
-    tft->setCursor(90, 105);
-    tft->printf("%.1f", lastSnr);
-    tft->setTextSize(1);
-    tft->print(" dB");
-
-    // USB status indicator
-    tft->setTextSize(1);
-    tft->setTextColor(COLOR_GOOD);
-    tft->setCursor(200, 105);
-    tft->print("USB ACTIVE");
+    gfx->setTextColor(rssiColor);
+    gfx->setCursor(5, 105);
+    gfx->printf("%.0f", lastRssi);
+    gfx->setTextSize(1);
+    gfx->print(" dBm");
+
+    // SNR, "--" in GFSK
+    gfx->setTextSize(2);
+    gfx->setCursor(90, 105);
+    if (isnan(lastSnr)) {
+        gfx->setTextColor(COLOR_LABEL);
+        gfx->print("--");
+    } else {
+        uint16_t snrColor = lastSnr > 5 ? COLOR_GOOD : (lastSnr > 0 ? COLOR_WARN : COLOR_BAD);
+        gfx->setTextColor(snrColor);
+        gfx->printf("%.1f", lastSnr);
+    }
+    gfx->setTextSize(1);
+    gfx->print(" dB");
+
+    // Frequency trim, shown while one is set or still applied
+    if (afcShown) {
+        gfx->setTextColor(COLOR_LABEL);
+        gfx->setCursor(5, 122);
+        gfx->printf("AFC %+.1f kHz", afcHz / 1000.0f);
+    }
 
     prevRssi = lastRssi;
     prevSnr = lastSnr;
+    prevAfcHz = afcHz;
+    prevAfcShown = afcShown;
+}
+
+void updateLinkDisplay() {
+    bool connected = bleConnected;
+    uint16_t mtu = bleMtu;
+    if (connected == prevBleConnected && mtu == prevBleMtu) {
+        return;
+    }
+
+    gfx->fillRect(200, 100, 115, 30, COLOR_BG);
+    gfx->setTextSize(1);
+    gfx->setCursor(200, 105);
+    if (connected) {
+        gfx->setTextColor(COLOR_GOOD);
+        gfx->print("CONNECTED");
+        gfx->setTextColor(COLOR_LABEL);
+        gfx->setCursor(200, 117);
+        gfx->print("MTU:");
+        gfx->setTextColor(COLOR_VALUE);
+        gfx->printf("%u", mtu);
+    } else {
+        gfx->setTextColor(COLOR_WARN);
+        gfx->print("ADVERTISING");
+    }
+
+    prevBleConnected = connected;
+    prevBleMtu = mtu;
 }
 
 void updateStatsDisplay() {
@@ -352,118 +1180,195 @@ void updateStatsDisplay() {
     }
     
     // Clear stats value area
-    tft->fillRect(5, 145, 310, 25, COLOR_BG);
+    gfx->fillRect(5, 145, 310, 25, COLOR_BG);
     
     // Stats row 1
-    tft->setTextSize(1);
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(5, 147);
-    tft->print("RX:");
-    tft->setTextColor(COLOR_VALUE);
-    tft->printf("%lu", packetsTotal);
-    
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(70, 147);
-    tft->print("FWD:");
-    tft->setTextColor(COLOR_GOOD);
-    tft->printf("%lu", packetsForwarded);
-    
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(140, 147);
-    tft->print("ERR:");
-    tft->setTextColor(packetsRejectedCrc + packetsRejectedNoRapt > 0 ? COLOR_BAD : COLOR_VALUE);
-    tft->printf("%lu", packetsRejectedCrc + packetsRejectedNoRapt);
+    gfx->setTextSize(1);
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(5, 147);
+    gfx->print("RX:");
+    gfx->setTextColor(COLOR_VALUE);
+    gfx->printf("%lu", packetsTotal);
+    
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(70, 147);
+    gfx->print("FWD:");
+    gfx->setTextColor(COLOR_GOOD);
+    gfx->printf("%lu", packetsForwarded);
+    
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(140, 147);
+    gfx->print("ERR:");
+    gfx->setTextColor(packetsRejectedCrc + packetsRejectedNoRapt > 0 ? COLOR_BAD : COLOR_VALUE);
+    gfx->printf("%lu", packetsRejectedCrc + packetsRejectedNoRapt);
     
     // Success rate
-    float rate = packetsTotal > 0 ? (100.0f * packetsForwarded / packetsTotal) : 0.0f;
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(210, 147);
-    tft->print("RATE:");
-    tft->setTextColor(rate > 90 ? COLOR_GOOD : (rate > 70 ? COLOR_WARN : COLOR_BAD));
-    tft->printf("%.1f%%", rate);
-    
-    // Stats row 2 - packet sizes
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(5, 159);
-    tft->print("TELEM:");
-    tft->setTextColor(COLOR_VALUE);
-    tft->printf("%lu", packetsSmall);
-
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(80, 159);
-    tft->print("IMAGE:");
-    tft->setTextColor(COLOR_VALUE);
-    tft->printf("%lu", packetsLarge);
+    // Suppressed duplicates were received fine, so they count as good
+    float rate = packetsTotal > 0 ? (100.0f * (packetsForwarded + packetsDuplicate) / packetsTotal) : 0.0f;
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(210, 147);
+    gfx->print("RATE:");
+    gfx->setTextColor(rate > 90 ? COLOR_GOOD : (rate > 70 ? COLOR_WARN : COLOR_BAD));
+    gfx->printf("%.1f%%", rate);
+    
+    // Stats row 2 - packet types
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(5, 159);
+    gfx->print("TELEM:");
+    gfx->setTextColor(COLOR_VALUE);
+    gfx->printf("%lu", packetsTelemetry);
+
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(80, 159);
+    gfx->print("IMAGE:");
+    gfx->setTextColor(COLOR_VALUE);
+    gfx->printf("%lu", packetsImage);
 
     // Output indicator
-    tft->setCursor(160, 159);
-    tft->setTextColor(COLOR_LABEL);
-    tft->print("OUT:");
-    tft->setTextColor(COLOR_GOOD);
-    tft->print("USB");
+    gfx->setCursor(160, 159);
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->print("OUT:");
+    gfx->setTextColor(COLOR_GOOD);
+#if ENABLE_USB
+    gfx->print(bleConnected ? "USB+BLE" : "USB");
+#else
+    gfx->print(bleConnected ? "BLE" : "-");
+#endif
+
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(240, 159);
+    gfx->print("BLE:");
+    gfx->setTextColor(COLOR_VALUE);
+    gfx->printf("%lu", blePacketsSent);
 
     prevPacketsForwarded = packetsForwarded;
     prevPacketsTotal = packetsTotal;
 }
 
+// Packets expected per second, received part green and lost part red on top, scaled to the busiest second
+void updateQualityDisplay() {
+    uint32_t now = millis();
+    if (now / 1000 == prevQualitySecond) return;
+    prevQualitySecond = now / 1000;
+
+    LqCounts bars[LQ_SECONDS];
+    uint32_t peak = 1;
+    for (int i = 0; i < LQ_SECONDS; i++) {
+        bars[i] = lqSecond(&linkQuality, LQ_SECONDS - i, now);
+        uint32_t expected = bars[i].good + bars[i].lost;
+        if (expected > peak) peak = expected;
+    }
+
+    // Quiet: nothing is known about the seconds since the last packet, so no figure and
+    // those seconds drawn as full-height loss until the next packet books them
+    LqCounts window = lqWindow(&linkQuality, LQ_SECONDS, now);
+    bool quiet = lqQuiet(&linkQuality, now);
+    uint32_t quietSecond = lqQuietSecond(&linkQuality);
+    gfx->fillRect(SPARK_X, 30, TFT_WIDTH - SPARK_X, 11, COLOR_BG);
+    gfx->setTextSize(1);
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(SPARK_X + 2, 32);
+    gfx->print("LINK 60s ");
+    if (quiet) {
+        gfx->setTextColor(COLOR_BAD);
+        gfx->print("--");
+    } else if (window.good + window.lost == 0) {
+        gfx->print("--");
+    } else {
+        float per = lqPer(window);
+        gfx->setTextColor(per < 1.0f ? COLOR_GOOD : (per < 10.0f ? COLOR_WARN : COLOR_BAD));
+        gfx->printf("%.1f%%", per);
+    }
+
+    gfx->fillRect(SPARK_X, SPARK_Y, LQ_SECONDS * SPARK_BAR_WIDTH, SPARK_HEIGHT, COLOR_BG);
+    for (int i = 0; i < LQ_SECONDS; i++) {
+        uint32_t expected = bars[i].good + bars[i].lost;
+        uint32_t ago = LQ_SECONDS - i;
+        if (quiet && now / 1000 >= ago && now / 1000 - ago >= quietSecond) {
+            gfx->fillRect(SPARK_X + i * SPARK_BAR_WIDTH, SPARK_Y, SPARK_BAR_WIDTH, SPARK_HEIGHT, COLOR_BAD);
+            continue;
+        }
+        if (expected == 0) continue;
+        int height = (int)((expected * SPARK_HEIGHT + peak - 1) / peak);
+        int lost = bars[i].lost ? (int)((bars[i].lost * SPARK_HEIGHT + peak - 1) / peak) : 0;
+        if (lost > height) lost = height;
+        int x = SPARK_X + i * SPARK_BAR_WIDTH;
+        int bottom = SPARK_Y + SPARK_HEIGHT;
+        if (height > lost) gfx->fillRect(x, bottom - height + lost, SPARK_BAR_WIDTH, height - lost, COLOR_GOOD);
+        if (lost > 0) gfx->fillRect(x, bottom - height, SPARK_BAR_WIDTH, lost, COLOR_BAD);
+    }
+}
+
 // ============================================================================
 // Battery Monitoring
 // ============================================================================
 
-float readBatteryVoltage() {
+// Battery voltage at the cell in mV. analogReadMilliVolts() applies the eFuse ADC
+// calibration, so no nominal full-scale voltage is assumed.
+uint32_t readBatteryMillivolts() {
     // Enable the battery voltage divider by turning on Q3->Q2
-    pinMode(ADC_CTRL_PIN, OUTPUT);
     digitalWrite(ADC_CTRL_PIN, HIGH);
-    delayMicroseconds(100);  // Let it settle (very brief, won't affect packet timing)
-    
-    // Take multiple readings and average for stability
-    uint32_t sum = 0;
-    const int samples = 4;
-    for (int i = 0; i < samples; i++) {
-        sum += analogRead(VBAT_READ_PIN);
-    }
-    
+    delayMicroseconds(100);  // Let it settle
+    uint32_t pinMv = analogReadMilliVolts(VBAT_READ_PIN);
+
     // Turn off the divider to save power
     digitalWrite(ADC_CTRL_PIN, LOW);
-    
-    // Calculate voltage
-    // ESP32-S3 ADC: 12-bit (0-4095), default attenuation gives ~0-2.5V range
-    // With ADC_ATTEN_DB_11, range is ~0-3.3V
-    float avgRaw = (float)sum / samples;
-    float vRead = (avgRaw / 4095.0f) * 3.3f;
-    float vBat = vRead * VBAT_DIVIDER_RATIO;
-    
-    return vBat;
+
+    batteryRawMillivolts = pinMv;
+    return (uint32_t)(pinMv * VBAT_DIVIDER_RATIO);
+}
+
+// Low-priority sampler on the non-radio core; keeps ADC work off loop() and the display
+void batteryTask(void* param) {
+    uint16_t window[VBAT_AVG_SAMPLES];
+    uint32_t sum = 0;
+    int next = 0;
+
+    // Seed the whole window so the first published value is already a real reading
+    uint32_t first = readBatteryMillivolts();
+    for (int i = 0; i < VBAT_AVG_SAMPLES; i++) window[i] = first;
+    sum = first * VBAT_AVG_SAMPLES;
+
+    TickType_t wake = xTaskGetTickCount();
+    for (;;) {
+        float volts = sum / (float)VBAT_AVG_SAMPLES / 1000.0f;
+        int percent = (int)(((volts - VBAT_MIN) / (VBAT_MAX - VBAT_MIN)) * 100.0f);
+        batteryVoltage = volts;
+        batteryPercent = constrain(percent, 0, 100);
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(VBAT_SAMPLE_MS));
+        uint32_t mv = readBatteryMillivolts();
+        sum += mv - window[next];
+        window[next] = mv;
+        next = (next + 1) % VBAT_AVG_SAMPLES;
+    }
+}
+
+void sendBatteryStatus() {
+    hostPrintf("BATT_OK:%.3fV %d%% pin=%umV avg=%dx%dms\n", batteryVoltage, batteryPercent,
+               batteryRawMillivolts, VBAT_AVG_SAMPLES, VBAT_SAMPLE_MS);
 }
 
 void updateBatteryDisplay() {
-    // Only update periodically (same rate as stats)
-    static uint32_t lastBatteryUpdate = 0;
-    if (millis() - lastBatteryUpdate < 1000) return;
-    lastBatteryUpdate = millis();
-    
-    // Read battery voltage
-    batteryVoltage = readBatteryVoltage();
-    
-    // Calculate percentage (linear approximation between min and max)
-    batteryPercent = (int)(((batteryVoltage - VBAT_MIN) / (VBAT_MAX - VBAT_MIN)) * 100.0f);
-    batteryPercent = constrain(batteryPercent, 0, 100);
+    // Published by batteryTask; linear percentage between VBAT_MIN and VBAT_MAX
+    float voltage = batteryVoltage;
+    int percent = batteryPercent;
     
     // Only redraw if voltage changed significantly (>0.05V)
-    if (abs(batteryVoltage - prevBatteryVoltage) < 0.05f) {
+    if (abs(voltage - prevBatteryVoltage) < 0.05f) {
         return;
     }
-    prevBatteryVoltage = batteryVoltage;
+    prevBatteryVoltage = voltage;
     
     // Draw battery indicator in header bar (right side)
     // Clear battery area first
-    tft->fillRect(250, 2, 68, 20, COLOR_HEADER);
+    gfx->fillRect(250, 2, 68, 20, COLOR_HEADER);
     
     // Choose color based on level
     uint16_t battColor;
-    if (batteryPercent > 50) {
+    if (percent > 50) {
         battColor = COLOR_GOOD;
-    } else if (batteryPercent > 20) {
+    } else if (percent > 20) {
         battColor = COLOR_WARN;
     } else {
         battColor = COLOR_BAD;
@@ -474,74 +1379,65 @@ void updateBatteryDisplay() {
     int battY = 5;
     int battW = 24;
     int battH = 12;
-    tft->drawRect(battX, battY, battW, battH, COLOR_TEXT);
-    tft->fillRect(battX + battW, battY + 3, 2, 6, COLOR_TEXT);  // Battery nub
+    gfx->drawRect(battX, battY, battW, battH, COLOR_TEXT);
+    gfx->fillRect(battX + battW, battY + 3, 2, 6, COLOR_TEXT);  // Battery nub
     
     // Fill battery level
-    int fillW = (battW - 4) * batteryPercent / 100;
+    int fillW = (battW - 4) * percent / 100;
     if (fillW > 0) {
-        tft->fillRect(battX + 2, battY + 2, fillW, battH - 4, battColor);
+        gfx->fillRect(battX + 2, battY + 2, fillW, battH - 4, battColor);
     }
     
     // Draw voltage text
-    tft->setTextSize(1);
-    tft->setTextColor(battColor);
-    tft->setCursor(280, 8);
-    tft->printf("%.2fV", batteryVoltage);
+    gfx->setTextSize(1);
+    gfx->setTextColor(battColor);
+    gfx->setCursor(280, 8);
+    gfx->printf("%.2fV", voltage);
 }
 
 void updateDisplay() {
-    uint32_t now = millis();
-    
-    // Only update display during idle periods
-    if (now - lastPacketTime < DISPLAY_IDLE_THRESHOLD_MS) {
-        return;
-    }
-    
-    // Rate limit display updates
-    if (now - lastDisplayUpdate < DISPLAY_UPDATE_INTERVAL_MS) {
-        return;
-    }
-    lastDisplayUpdate = now;
-    
     if (displayNeedsFullRedraw) {
         drawStaticUI();
     }
     
     updateSignalDisplay();
+    updateLinkDisplay();
     updateStatsDisplay();
+    updateQualityDisplay();
     updateBatteryDisplay();
 }
 
 void showWaitingScreen() {
-    tft->fillScreen(COLOR_BG);
+    gfx->fillScreen(COLOR_BG);
 
-    tft->setTextColor(COLOR_ACCENT);
-    tft->setTextSize(2);
-    tft->setCursor(20, 20);
-    tft->print("RAPTORHAB MODEM");
+    gfx->setTextColor(COLOR_ACCENT);
+    gfx->setTextSize(2);
+    gfx->setCursor(20, 20);
+    gfx->print("RAPTORHAB MODEM");
 
-    tft->setTextColor(COLOR_TEXT);
-    tft->setTextSize(1);
-    tft->setCursor(20, 50);
-    tft->print("Waiting for configuration...");
+    gfx->setTextColor(COLOR_TEXT);
+    gfx->setTextSize(1);
+    gfx->setCursor(20, 50);
+    gfx->print("Waiting for configuration...");
 
-    tft->setCursor(20, 70);
-    tft->print("Connect via USB serial");
+    gfx->setCursor(20, 70);
+    gfx->print("Connect via USB serial or BLE");
 
     // Default settings info
-    tft->setTextColor(COLOR_WARN);
-    tft->setCursor(20, 100);
-    tft->print("Default: 915MHz, 96kbps");
-
-    tft->setTextColor(COLOR_LABEL);
-    tft->setCursor(20, 120);
-    tft->printf("Timeout: %ds", CONFIG_TIMEOUT_MS / 1000);
+    gfx->setTextColor(COLOR_WARN);
+    gfx->setCursor(20, 100);
+    gfx->print("Default: 915MHz, 96kbps");
+
+    gfx->setTextColor(COLOR_LABEL);
+    gfx->setCursor(20, 120);
+    gfx->printf("Timeout: %ds", CONFIG_TIMEOUT_MS / 1000);
+    displayFlush();
 }
 
 void showConfiguredScreen() {
     displayNeedsFullRedraw = true;
     drawStaticUI();
+    displayFlush();
 }
 
 // ============================================================================
@@ -551,37 +1447,18 @@ void showConfiguredScreen() {
 bool waitForConfiguration() {
     showWaitingScreen();
 
-    Serial.println("\n[CONFIG] Waiting for configuration via USB...");
+    Serial.println("\n[CONFIG] Waiting for configuration via USB or BLE...");
     Serial.printf("[CONFIG] Send: CFG:<freq>,<bitrate>,<deviation>,<bandwidth>,<preamble>\n");
     Serial.printf("[CONFIG] Example: CFG:915.0,96.0,50.0,467.0,32\n");
     Serial.printf("[CONFIG] Timeout: %d seconds (will use defaults)\n\n", CONFIG_TIMEOUT_MS / 1000);
 
-    String usbBuffer = "";
     uint32_t startTime = millis();
     uint32_t lastDot = 0;
 
     while (millis() - startTime < CONFIG_TIMEOUT_MS) {
-        // Check USB Serial
-        while (Serial.available()) {
-            char c = Serial.read();
-            if (c == '\n' || c == '\r') {
-                if (usbBuffer.length() > 0) {
-                    Serial.printf("[USB] Received: %s\n", usbBuffer.c_str());
-                    if (usbBuffer.startsWith("CFG:")) {
-                        if (parseConfigCommand(usbBuffer)) {
-                            Serial.printf("CFG_OK:%.1f,%.1f,%.1f,%.1f,%d\n",
-                                         rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen);
-                            return true;
-                        } else {
-                            Serial.println("CFG_ERR:Invalid parameters");
-                        }
-                    }
-                    usbBuffer = "";
-                }
-            } else {
-                usbBuffer += c;
-            }
-        }
+        // Same parser as at runtime; returns once a CFG: line was accepted
+        if (pollHostCommands()) return true;
+        if (scanStartPending.load(std::memory_order_relaxed)) return false;   // SCAN: starts the radio on the defaults and looks
 
         // Progress indicator
         if (millis() - lastDot > 1000) {
@@ -590,10 +1467,11 @@ bool waitForConfiguration() {
 
             // Update display with countdown
             int remaining = (CONFIG_TIMEOUT_MS - (millis() - startTime)) / 1000;
-            tft->fillRect(100, 120, 50, 10, COLOR_BG);
-            tft->setTextColor(COLOR_LABEL);
-            tft->setCursor(100, 120);
-            tft->printf("%ds", remaining);
+            gfx->fillRect(100, 120, 50, 10, COLOR_BG);
+            gfx->setTextColor(COLOR_LABEL);
+            gfx->setCursor(100, 120);
+            gfx->printf("%ds", remaining);
+            displayFlush();
         }
 
         delay(10);
@@ -603,94 +1481,652 @@ bool waitForConfiguration() {
     return false;
 }
 
-bool parseConfigCommand(const String& cmd) {
-    // Expected: CFG:<freq>,<bitrate>,<deviation>,<bandwidth>,<preamble>
-    if (!cmd.startsWith("CFG:")) return false;
-    
-    String params = cmd.substring(4);
-    int comma1 = params.indexOf(',');
-    int comma2 = params.indexOf(',', comma1 + 1);
-    int comma3 = params.indexOf(',', comma2 + 1);
-    int comma4 = params.indexOf(',', comma3 + 1);
-    
-    if (comma1 < 0 || comma2 < 0 || comma3 < 0 || comma4 < 0) {
-        Serial.println("[CONFIG] Parse error: missing commas");
+// Returns true once a valid CFG: line has been applied
+bool handleConfigLine(const char* line, const char* source) {
+    logPrintf("[%s] Received: %s\n", source, line);
+    if (strncmp(line, "CFG:", 4) != 0) {
+        handleHostCommand(line);
         return false;
     }
-    
-    float freq = params.substring(0, comma1).toFloat();
-    float bitrate = params.substring(comma1 + 1, comma2).toFloat();
-    float deviation = params.substring(comma2 + 1, comma3).toFloat();
-    float bandwidth = params.substring(comma3 + 1, comma4).toFloat();
-    int preamble = params.substring(comma4 + 1).toInt();
-    
-    // Validate
-    if (freq < 150.0 || freq > 960.0) {
-        Serial.printf("[CONFIG] Invalid frequency: %.1f\n", freq);
+
+    RfConfig cfg;
+    if (!parseConfigCommand(line, &cfg)) {
+        hostPrintf("CFG_ERR:Invalid parameters\n");
         return false;
     }
-    if (bitrate < 1.0 || bitrate > 300.0) {
-        Serial.printf("[CONFIG] Invalid bitrate: %.1f\n", bitrate);
-        return false;
+
+    if (configured) {
+        // Radio is running: hand the new values to the radio task and wait for the result
+        int state = requestRadioReconfig(cfg);
+        if (state != RADIOLIB_ERR_NONE) {
+            hostPrintf("CFG_ERR:Radio rejected parameters (%d)\n", state);
+            return false;
+        }
+        uint8_t changed = radioRetuneChanged;
+        hostPrintf("[RADIO] Retuned%s%s%s%s%s blind=%luus\n",
+                   changed & RETUNE_FREQUENCY ? " freq" : "", changed & RETUNE_BITRATE ? " br" : "",
+                   changed & RETUNE_DEVIATION ? " dev" : "", changed & RETUNE_BANDWIDTH ? " bw" : "",
+                   changed & RETUNE_PREAMBLE ? " pre" : "", radioRetuneBlindUs);
+    } else {
+        rfFrequency = cfg.frequency;
+        rfBitrate = cfg.bitrate;
+        rfDeviation = cfg.deviation;
+        rfRxBandwidth = cfg.rxBandwidth;
+        rfPreambleLen = cfg.preambleLen;
     }
-    if (deviation < 1.0 || deviation > 200.0) {
-        Serial.printf("[CONFIG] Invalid deviation: %.1f\n", deviation);
+
+    configSource = source;
+    displayNeedsFullRedraw = true;
+    saveRfConfig();    // Next boot starts listening on these straight away
+    hostPrintf("CFG_OK:%.1f,%.1f,%.1f,%.1f,%d\n",
+               rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen);
+    return true;
+}
+
+bool parseConfigCommand(const char* cmd, RfConfig* cfg) {
+    // Expected: CFG:<freq>,<bitrate>,<deviation>,<bandwidth>,<preamble>
+    if (!rfConfigParse(cmd, cfg)) {
+        logPrintf("[CONFIG] Parse error: expected 5 comma-separated values\n");
         return false;
     }
-    if (bandwidth < 10.0 || bandwidth > 500.0) {
-        Serial.printf("[CONFIG] Invalid bandwidth: %.1f\n", bandwidth);
-        return false;
+    if (!validateRfConfig(*cfg)) return false;
+
+    logPrintf("[CONFIG] Accepted: Freq=%.1f BR=%.1f Dev=%.1f BW=%.1f Pre=%d\n",
+              cfg->frequency, cfg->bitrate, cfg->deviation, cfg->rxBandwidth, cfg->preambleLen);
+    return true;
+}
+
+// Range check shared by CFG: and the saved NVS copy
+bool validateRfConfig(const RfConfig& cfg) {
+    const char* field = rfConfigInvalidField(cfg);
+    if (field == nullptr) return true;
+    logPrintf("[CONFIG] Invalid %s: Freq=%.1f BR=%.1f Dev=%.1f BW=%.1f Pre=%d\n", field,
+              cfg.frequency, cfg.bitrate, cfg.deviation, cfg.rxBandwidth, cfg.preambleLen);
+    return false;
+}
+
+// ============================================================================
+// Saved Configuration (NVS)
+// ============================================================================
+
+Preferences prefs;
+
+// Adopt the last accepted CFG: if one was saved; false on first boot or a bad record
+bool loadSavedConfig() {
+    RfConfig cfg;
+    size_t n = 0;
+    if (prefs.begin(NVS_NAMESPACE, true)) {
+        n = prefs.getBytes(NVS_KEY_RF_CONFIG, &cfg, sizeof(cfg));
+        prefs.end();
     }
-    if (preamble < 8 || preamble > 65535) {
-        Serial.printf("[CONFIG] Invalid preamble: %d\n", preamble);
-        return false;
+    if (n != sizeof(cfg) || !validateRfConfig(cfg)) return false;
+
+    rfFrequency = cfg.frequency;
+    rfBitrate = cfg.bitrate;
+    rfDeviation = cfg.deviation;
+    rfRxBandwidth = cfg.rxBandwidth;
+    rfPreambleLen = cfg.preambleLen;
+    return true;
+}
+
+// Store the active config; skipped when unchanged since a flash write stalls both cores
+void saveRfConfig() {
+    RfConfig cfg = { rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen };
+    RfConfig stored;
+    if (!prefs.begin(NVS_NAMESPACE, false)) {
+        logPrintf("[NVS] Open failed - config not saved\n");
+        return;
     }
-    
-    rfFrequency = freq;
-    rfBitrate = bitrate;
-    rfDeviation = deviation;
-    rfRxBandwidth = bandwidth;
-    rfPreambleLen = preamble;
-    
-    Serial.printf("[CONFIG] Applied: Freq=%.1f BR=%.1f Dev=%.1f BW=%.1f Pre=%d\n",
-                  rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen);
-    
+    if (prefs.getBytes(NVS_KEY_RF_CONFIG, &stored, sizeof(stored)) != sizeof(stored) ||
+        memcmp(&stored, &cfg, sizeof(cfg)) != 0) {
+        prefs.putBytes(NVS_KEY_RF_CONFIG, &cfg, sizeof(cfg));
+    }
+    prefs.end();
+}
+
+void forgetSavedConfig() {
+    if (prefs.begin(NVS_NAMESPACE, false)) {
+        prefs.remove(NVS_KEY_RF_CONFIG);
+        prefs.end();
+    }
+}
+
+// ============================================================================
+// Power Management
+// ============================================================================
+//
+// PWR:ON lets the CPU scale between POWER_MIN_MHZ and POWER_MAX_MHZ and, when
+// the core was built with tickless idle, enter automatic light sleep whenever
+// every task is blocked. The SX1262 keeps listening on its own and DIO1 (an RTC
+// GPIO) is the wake source; the DIO1 timestamp is only taken once the CPU is
+// awake, so the wake-up time shows in RX>FWD and E2E rather than ISR>RD. An
+// edge that sleep swallowed is still found by the radio task's DIO1 poll.
+// Light sleep stops the USB port, so a NO_LIGHT_SLEEP lock is held while a USB
+// host is attached; BLE and Wi-Fi hold their own. The backlight timeout and
+// loop() idling do not need esp_pm and work on any core.
+
+static esp_pm_lock_handle_t powerUsbLock = nullptr;
+
+// loop(): hold light sleep off while a USB host is attached, let it go once the host is gone
+void powerUsbUpdate() {
+    bool hold = powerLightSleep && (bool)Serial;
+    if (powerUsbLock == nullptr || hold == powerUsbHold) return;
+    if (hold) {
+        esp_pm_lock_acquire(powerUsbLock);
+    } else {
+        esp_pm_lock_release(powerUsbLock);
+    }
+    powerUsbHold = hold;
+}
+
+// Switch the mode; DFS and light sleep only where the core supports them
+static void powerApply(bool enable) {
+    // Taken before light sleep can start, so a host sending PWR:ON keeps its port
+    if (enable && powerUsbLock != nullptr && !powerUsbHold && (bool)Serial) {
+        esp_pm_lock_acquire(powerUsbLock);
+        powerUsbHold = true;
+    }
+
+    esp_pm_config_esp32s3_t pm = { POWER_MAX_MHZ, enable ? POWER_MIN_MHZ : POWER_MAX_MHZ, enable };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err == ESP_ERR_NOT_SUPPORTED && enable) {
+        // No tickless idle in this core: frequency scaling alone
+        pm.light_sleep_enable = false;
+        err = esp_pm_configure(&pm);
+    }
+    bool sleep = err == ESP_OK && pm.light_sleep_enable;
+    if (sleep) {
+        esp_sleep_enable_ext1_wakeup(1ULL << LORA_DIO1, ESP_EXT1_WAKEUP_ANY_HIGH);
+    } else {
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_EXT1);
+    }
+    powerDfs = err == ESP_OK && enable;
+    powerLightSleep = sleep;
+    powerSaveEnabled = enable;
+    powerUsbUpdate();
+
+    // Fresh RX>FWD window, so the numbers belong to the mode now in effect
+    latRxToForwardResetPending = true;
+}
+
+void initPower() {
+    bool enable = false;
+    if (prefs.begin(NVS_NAMESPACE, true)) {
+        enable = prefs.getUChar(NVS_KEY_POWER_SAVE, 0) != 0;
+        prefs.end();
+    }
+    powerActivityMs = millis();
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "usb", &powerUsbLock) != ESP_OK) powerUsbLock = nullptr;
+    if (enable) {
+        powerApply(true);
+        logPrintf("[PWR] Power save on (DFS %s, light sleep %s)\n",
+                  powerDfs ? "on" : "unavailable", powerLightSleep ? "on" : "unavailable");
+    }
+}
+
+// Radio task: DIO1 high with no interrupt seen means the edge fell into a sleep transition
+bool powerCheckLostEdge() {
+    if (!powerLightSleep || radio == nullptr || digitalRead(LORA_DIO1) != HIGH || dio1Pending) return false;
+    dio1Micros = esp_timer_get_time();
+    powerLostEdges++;
     return true;
 }
 
+// Display task: backlight off after POWER_BACKLIGHT_IDLE_MS without packets, commands or the button
+void powerUpdateBacklight() {
+    uint32_t now = millis();
+    if (digitalRead(USER_BUTTON) == LOW) powerActivityMs = now;
+    uint32_t since = now - powerActivityMs;
+    uint32_t sincePacket = now - lastPacketTime;
+    if (sincePacket < since) since = sincePacket;
+
+    bool on = !powerSaveEnabled || since < POWER_BACKLIGHT_IDLE_MS;
+    if (on != backlightOn) {
+        digitalWrite(TFT_LED_EN, on ? HIGH : LOW);
+        backlightOn = on;
+        if (on) displayNeedsFullRedraw = true;      // Nothing was drawn while it was off
+    }
+}
+
+// PWR:ON / PWR:OFF, saved for the next boot
+void handlePowerCommand(const char* arg) {
+    bool enable;
+    if (strcmp(arg, "ON") == 0) {
+        enable = true;
+    } else if (strcmp(arg, "OFF") == 0) {
+        enable = false;
+    } else {
+        hostPrintf("PWR_ERR:Expected ON or OFF\n");
+        return;
+    }
+    powerApply(enable);
+    if (prefs.begin(NVS_NAMESPACE, false)) {
+        prefs.putUChar(NVS_KEY_POWER_SAVE, enable ? 1 : 0);
+        prefs.end();
+    }
+    hostPrintf("PWR_OK:%s dfs=%d sleep=%d\n", enable ? "on" : "off", powerDfs ? 1 : 0, powerLightSleep ? 1 : 0);
+}
+
+void sendPowerStatus() {
+    const LatencyHistogram* h = &latRxToForward;
+    hostPrintf("PWR_OK:%s cpu=%lu-%dMHz dfs=%d sleep=%d usb=%d backlight=%s lost=%lu rx>fwd n=%lu avg=%lu p99<=%lu max=%lu us\n",
+               powerSaveEnabled ? "on" : "off", powerDfs ? (uint32_t)POWER_MIN_MHZ : getCpuFrequencyMhz(),
+               POWER_MAX_MHZ, powerDfs ? 1 : 0, powerLightSleep ? 1 : 0, powerUsbHold ? 1 : 0,
+               backlightOn ? "on" : "off", powerLostEdges,
+               h->count, h->count ? (uint32_t)(h->totalUs / h->count) : 0, latencyPercentile(h, 99), h->maxUs);
+}
+
+// ============================================================================
+// Runtime Host Commands
+// ============================================================================
+
+void serialLock() {
+    if (serialMutex) xSemaphoreTake(serialMutex, portMAX_DELAY);
+}
+
+void serialUnlock() {
+    if (serialMutex) xSemaphoreGive(serialMutex);
+}
+
+// Write a whole frame to the CDC port, serialLock() held; returns the bytes written.
+// HWCDC has a TX buffer larger than any frame: all or nothing, never blocking.
+// TinyUSB's CDC FIFO is smaller than most frames, so once the host is taking data
+// the frame is fed in as the FIFO drains, for at most CDC_FRAME_WRITE_MS, with the
+// lock held so no text line lands inside it. A frame cut short there is torn and
+// the host drops it on its CRC.
+size_t serialWriteFrame(const uint8_t* frame, size_t len) {
+    if (!Serial) return 0;
+#if ARDUINO_USB_MODE
+    if (Serial.availableForWrite() < (int)len) return 0;
+    return Serial.write(frame, len);
+#else
+    if (Serial.availableForWrite() <= 0) return 0;
+    size_t done = 0;
+    int64_t start = esp_timer_get_time();
+    while (done < len) {
+        int room = Serial.availableForWrite();
+        if (room > 0) {
+            done += Serial.write(frame + done, (size_t)room < len - done ? (size_t)room : len - done);
+        } else if (esp_timer_get_time() - start > CDC_FRAME_WRITE_MS * 1000LL) {
+            break;
+        } else {
+            vTaskDelay(1);
+        }
+    }
+    return done;
+#endif
+}
+
+// Format into a HOST_LINE_MAX buffer; a line cut short still ends in '\n', so the
+// host's line parser never merges it with the next one
+static int hostFormat(char* buf, const char* fmt, va_list args) {
+    int n = vsnprintf(buf, HOST_LINE_MAX, fmt, args);
+    if (n < 0) return 0;
+    if (n >= HOST_LINE_MAX) {
+        n = HOST_LINE_MAX - 1;
+        buf[n - 1] = '\n';
+    }
+    return n;
+}
+
+// Text reply to the host on USB and, when connected, BLE
+void hostPrintf(const char* fmt, ...) {
+    char buf[HOST_LINE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    int n = hostFormat(buf, fmt, args);
+    va_end(args);
+    if (n == 0) return;
+
+    serialLock();
+    Serial.write((const uint8_t*)buf, n);
+    serialUnlock();
+    bleSendText(buf, n);
+}
+
+// Diagnostic line on USB only, never torn into a frame
+void logPrintf(const char* fmt, ...) {
+    char buf[HOST_LINE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    int n = hostFormat(buf, fmt, args);
+    va_end(args);
+    if (n == 0) return;
+
+    serialLock();
+    Serial.write((const uint8_t*)buf, n);
+    serialUnlock();
+}
+
+// Commands accepted both while waiting for CFG and during reception
+void handleHostCommand(const char* cmd) {
+    powerActivityMs = millis();     // Any command counts as activity for the backlight
+    if (strncmp(cmd, "FMT:", 4) == 0) {
+        int format = atoi(cmd + 4);
+        if (format == 1 || format == 2) {
+            hostFrameFormat = format;
+            hostPrintf("FMT_OK:%d\n", format);
+        } else {
+            hostPrintf("FMT_ERR:Unsupported format\n");
+        }
+    } else if (strcmp(cmd, "CFG?") == 0) {
+        hostPrintf("CFG_OK:%.1f,%.1f,%.1f,%.1f,%d src=%s blind=%luus\n",
+                   rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen, configSource,
+                   radioRetuneBlindUs);
+    } else if (strcmp(cmd, "NVS?") == 0) {
+        RfConfig saved = { rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen };
+        bool have = prefs.begin(NVS_NAMESPACE, true) &&
+                    prefs.getBytes(NVS_KEY_RF_CONFIG, &saved, sizeof(saved)) == sizeof(saved);
+        prefs.end();
+        if (have) {
+            hostPrintf("NVS_OK:%.1f,%.1f,%.1f,%.1f,%d\n", saved.frequency, saved.bitrate,
+                       saved.deviation, saved.rxBandwidth, saved.preambleLen);
+        } else {
+            hostPrintf("NVS_OK:none\n");
+        }
+    } else if (strcmp(cmd, "NVS:CLEAR") == 0) {
+        forgetSavedConfig();
+        hostPrintf("NVS_OK:cleared\n");
+    } else if (strcmp(cmd, "WIFI?") == 0) {
+        sendNetStatus();
+    } else if (strncmp(cmd, "WIFI:", 5) == 0) {
+        handleWifiCommand(cmd + 5);
+    } else if (strcmp(cmd, "AFC?") == 0) {
+        sendAfcStatus();
+    } else if (strncmp(cmd, "AFC:", 4) == 0) {
+        handleAfcCommand(cmd + 4);
+    } else if (strcmp(cmd, "SCAN?") == 0) {
+        sendScanStatus();
+    } else if (strncmp(cmd, "SCAN:", 5) == 0) {
+        handleScanCommand(cmd + 5);
+    } else if (strcmp(cmd, "LQ?") == 0) {
+        sendLqStatus();
+    } else if (strncmp(cmd, "LQ:", 3) == 0) {
+        handleLqCommand(cmd + 3);
+    } else if (strcmp(cmd, "SCHED?") == 0) {
+        sendSchedStatus();
+    } else if (strcmp(cmd, "BATT?") == 0) {
+        sendBatteryStatus();
+    } else if (strcmp(cmd, "PWR?") == 0) {
+        sendPowerStatus();
+    } else if (strncmp(cmd, "PWR:", 4) == 0) {
+        handlePowerCommand(cmd + 4);
+    } else if (strcmp(cmd, "STATS?") == 0) {
+        reportStats(STATS_FORMAT_TEXT);
+    } else if (strncmp(cmd, "STATS:", 6) == 0) {
+        handleStatsCommand(cmd + 6);
+    } else if (strcmp(cmd, "LAT?") == 0) {
+        sendLatencyReport();
+    } else if (strcmp(cmd, "LAT:BIN") == 0) {
+        sendLatencyFrame();
+#if ENABLE_BENCHMARKS
+    } else if (strcmp(cmd, "BENCH") == 0) {
+        runBenchmarks();
+#endif
+    } else if (strcmp(cmd, "LAT:RESET") == 0) {
+        latencyReset();
+        hostPrintf("LAT_OK\n");
+    } else if (strncmp(cmd, "DEDUP:", 6) == 0) {
+        dedupEnabled = atoi(cmd + 6) != 0;
+        hostPrintf("DEDUP_OK:%d\n", dedupEnabled ? 1 : 0);
+    } else if (strcmp(cmd, "IMG?") == 0) {
+        for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+            if (imageTracks[i].active) reportImageTrack(&imageTracks[i]);
+        }
+        sendImageOutputStatus();
+    } else if (strncmp(cmd, "IMG:OUT:", 8) == 0) {
+        handleImageOutputCommand(cmd + 8);
+    } else if (strncmp(cmd, "IMG:SEND:", 9) == 0) {
+        int id = atoi(cmd + 9);
+        bool have = false;
+        for (int i = 0; i < IMAGE_TRACK_SLOTS; i++) {
+            const ImageTrack* t = &imageTracks[i];
+            have |= t->active && t->decoded && t->image != nullptr && t->imageId == id;
+        }
+        if (have && imageOutputs.load(std::memory_order_relaxed) != 0) {
+            imageResendId.store(id, std::memory_order_relaxed);
+            if (forwardTaskHandle) xTaskNotifyGive(forwardTaskHandle);
+            hostPrintf("IMG_OK:send=%d\n", id);
+        } else {
+            hostPrintf("IMG_ERR:No decoded image %d for IMG:OUT outputs\n", id);
+        }
+    } else if (strncmp(cmd, "IMG:", 4) == 0) {
+        imageTrackingEnabled = atoi(cmd + 4) != 0 && imageTracks[0].bitmap != nullptr;
+        hostPrintf("IMG_OK:%d\n", imageTrackingEnabled ? 1 : 0);
+    } else if (strcmp(cmd, "LINK?") == 0) {
+        sendLinkStatus();
+    } else if (strcmp(cmd, "SINKS?") == 0) {
+        sendSinkStatus();
+    } else if (strcmp(cmd, "QOS?") == 0) {
+        sendOutputStatus();
+    } else if (strncmp(cmd, "QOS:", 4) == 0) {
+        int watermark = atoi(cmd + 4);
+        if (watermark >= 1 && watermark <= OUTPUT_POOL_SLOTS) {
+            outputWatermark = watermark;
+            hostPrintf("QOS_OK:wm=%d\n", watermark);
+        } else {
+            hostPrintf("QOS_ERR:Watermark must be 1-%d\n", OUTPUT_POOL_SLOTS);
+        }
+    } else if (strcmp(cmd, "INJ?") == 0) {
+        sendInjectStatus();
+    } else if (strncmp(cmd, "INJ:", 4) == 0) {
+        handleInjectCommand(cmd + 4);
+    } else if (strcmp(cmd, "RPL?") == 0) {
+        sendReplayStatus();
+    } else if (strcmp(cmd, "RPL:CLEAR") == 0) {
+        replayClearRequested = true;
+        if (forwardTaskHandle) xTaskNotifyGive(forwardTaskHandle);
+        hostPrintf("RPL_OK\n");
+    } else if (strncmp(cmd, "RPL:", 4) == 0) {
+        int ratio = atoi(cmd + 4);
+        if (ratio >= 1 && ratio <= REPLAY_MAX_RATIO) {
+            replayRatio = ratio;
+            hostPrintf("RPL_OK:ratio=%d\n", ratio);
+        } else {
+            hostPrintf("RPL_ERR:Ratio must be 1-%d\n", REPLAY_MAX_RATIO);
+        }
+    } else {
+        hostPrintf("CMD_ERR:Unknown command\n");
+    }
+}
+
+// ============================================================================
+// Benchmarks (cycle counter; same kernels as the native environment)
+// ============================================================================
+
+#if ENABLE_BENCHMARKS
+static uint32_t benchCycles() {
+    return ESP.getCycleCount();
+}
+
+static void benchCrc32Rom(uint32_t) {
+    benchSink ^= esp_rom_crc32_le(0, benchPacket(), BENCH_PACKET_LEN);
+}
+
+static void benchReport(const BenchResult& result) {
+    char line[96];
+    benchFormat(line, sizeof(line), result);
+    hostPrintf("[BENCH] %s %lu cyc/op\n", line, result.ticks / result.ops);
+}
+
+// Runs in loop(); the radio and forward tasks keep running and can skew the numbers
+void runBenchmarks() {
+    uint32_t ticksPerUs = getCpuFrequencyMhz();
+    hostPrintf("[BENCH] %d ops per stage, %d byte packets, %lu MHz\n",
+               BENCH_TARGET_OPS, BENCH_PACKET_LEN, ticksPerUs);
+    benchRunCore(BENCH_TARGET_OPS, benchCycles, ticksPerUs, benchReport);
+    benchReport(benchMeasure("crc32-rom", benchCrc32Rom, BENCH_PACKET_LEN,
+                             BENCH_TARGET_OPS, benchCycles, ticksPerUs));
+    hostPrintf("BENCH_OK\n");
+}
+#endif
+
+// ============================================================================
+// Host Command Parser
+// ============================================================================
+//
+// CommandParser (raptor_parse.h) is fed one byte at a time from loop()
+
+CommandParser usbParser;
+
+// Handles every complete line from USB and BLE; returns true if a CFG: was accepted
+bool pollHostCommands() {
+    bool accepted = false;
+
+    // Only what is buffered now, so a flood of input can't starve the caller
+    for (int n = Serial.available(); n > 0; n--) {
+        int c = Serial.read();
+        if (c < 0) break;
+        CommandFeedResult result = commandParserFeed(&usbParser, (char)c);
+        if (result == COMMAND_READY) {
+            accepted |= handleConfigLine(usbParser.line, "USB");
+        } else if (result == COMMAND_TOO_LONG) {
+            hostPrintf("CMD_ERR:Line too long\n");
+        }
+    }
+
+    char bleLine[BLE_CMD_MAX_LEN];
+    while (bleReceiveCommand(bleLine)) {
+        accepted |= handleConfigLine(bleLine, "BLE");
+    }
+    return accepted;
+}
+
 // ============================================================================
 // Radio Initialization
 // ============================================================================
 
+// startReceive() with RX_IRQ_FLAGS in the RX_CONTINUOUS mode; every full (re)start of RX goes through here
+static int rxStartReceive() {
+    return radio->startReceive(RX_TIMEOUT_RAW, RX_IRQ_FLAGS, RADIOLIB_SX126X_IRQ_RX_DONE);
+}
+
+// SetRx argument for the raw re-arm and retune paths, the same mode as rxStartReceive()
+static const uint8_t rxSetRxTimeout[3] = {
+    (uint8_t)(RX_TIMEOUT_RAW >> 16), (uint8_t)(RX_TIMEOUT_RAW >> 8), (uint8_t)RX_TIMEOUT_RAW
+};
+
 bool initializeRadio() {
-    Serial.println("[RADIO] Initializing SX1262...");
+    logPrintf("[RADIO] Initializing SX1262...\n");
     
     spi = new SPIClass(FSPI);
     spi->begin(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_NSS);
     
-    Module* mod = new Module(LORA_NSS, LORA_DIO1, LORA_RST, LORA_BUSY, *spi);
+    Module* mod = new Module(LORA_NSS, LORA_DIO1, LORA_RST, LORA_BUSY, *spi,
+                             SPISettings(LORA_SPI_FREQ, MSBFIRST, SPI_MODE0));
     radio = new SX1262(mod);
     
-    Serial.printf("[RADIO] Initializing FSK: Freq=%.1f BR=%.1f Dev=%.1f BW=%.1f Pre=%d\n",
-                  rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen);
-    
-    int state = radio->beginFSK(rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, 10, rfPreambleLen, 1.8, false);
-    
+    int state = configureRadio();
     if (state != RADIOLIB_ERR_NONE) {
-        Serial.printf("[ERROR] FSK init failed: %d\n", state);
+        logPrintf("[ERROR] FSK init failed: %d\n", state);
         return false;
     }
     
+    logPrintf("[RADIO] SX1262 initialized successfully\n");
+    return true;
+}
+
+// Full FSK setup from the rf* globals, ending in RX; also used to retune at runtime
+int configureRadio() {
+    logPrintf("[RADIO] Initializing FSK: Freq=%.1f BR=%.1f Dev=%.1f BW=%.1f Pre=%d\n",
+              rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen);
+    
+    int state = radio->beginFSK(rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, 10, rfPreambleLen, 1.8, false);
+    if (state != RADIOLIB_ERR_NONE) return state;
+    
     radio->setSyncWord(const_cast<uint8_t*>(SYNC_WORD), SYNC_WORD_LEN);
     radio->variablePacketLengthMode(MAX_PACKET_SIZE);
     radio->setDataShaping(RF_DATA_SHAPING);
     radio->setCRC(0);
     
     radio->setDio1Action(onPacketReceived);
-    radio->startReceive();
-    
-    Serial.println("[RADIO] SX1262 initialized successfully");
-    return true;
+    return rxStartReceive();
+}
+
+// Image rejection calibration range used by SX126x::setFrequency() for a frequency
+static int imageCalibrationBand(float freq) {
+    if (freq > 900.0) return 5;
+    if (freq > 850.0) return 4;
+    if (freq > 770.0) return 3;
+    if (freq > 460.0) return 2;
+    if (freq > 425.0) return 1;
+    return 0;
+}
+
+// Radio task: retune the running radio with only the settings that changed, in
+// standby so the sync word, shaping and packet mode stay put. If the radio
+// rejects a value it is fully reconfigured with the previous settings.
+void applyPendingRadioConfig() {
+    RfConfig previous = { rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen };
+    const RfConfig& next = pendingRfConfig;
+    uint8_t changed = 0;
+    if (next.frequency != previous.frequency) changed |= RETUNE_FREQUENCY;
+    if (next.bitrate != previous.bitrate) changed |= RETUNE_BITRATE;
+    if (next.deviation != previous.deviation) changed |= RETUNE_DEVIATION;
+    if (next.rxBandwidth != previous.rxBandwidth) changed |= RETUNE_BANDWIDTH;
+    if (next.preambleLen != previous.preambleLen) changed |= RETUNE_PREAMBLE;
+
+    int state = RADIOLIB_ERR_NONE;
+    int64_t start = esp_timer_get_time();
+    if (changed) {
+        state = radio->standby();
+        if (state == RADIOLIB_ERR_NONE && (changed & RETUNE_FREQUENCY)) {
+            // Image calibration costs milliseconds; only redo it when leaving the band
+            bool calibrate = imageCalibrationBand(next.frequency) != imageCalibrationBand(previous.frequency);
+            state = radio->setFrequency(next.frequency, calibrate);
+        }
+        if (state == RADIOLIB_ERR_NONE && (changed & RETUNE_BITRATE)) {
+            state = radio->setBitRate(next.bitrate);
+        }
+        if (state == RADIOLIB_ERR_NONE && (changed & RETUNE_DEVIATION)) {
+            state = radio->setFrequencyDeviation(next.deviation);
+        }
+        if (state == RADIOLIB_ERR_NONE && (changed & RETUNE_BANDWIDTH)) {
+            state = radio->setRxBandwidth(next.rxBandwidth);
+        }
+        if (state == RADIOLIB_ERR_NONE && (changed & RETUNE_PREAMBLE)) {
+            state = radio->setPreambleLength(next.preambleLen);
+        }
+
+        if (state == RADIOLIB_ERR_NONE) {
+            rfFrequency = next.frequency;
+            rfBitrate = next.bitrate;
+            rfDeviation = next.deviation;
+            rfRxBandwidth = next.rxBandwidth;
+            rfPreambleLen = next.preambleLen;
+            state = rxStartReceive();
+        }
+        if (state != RADIOLIB_ERR_NONE) {
+            // Partly applied: start over from the last good settings
+            rfFrequency = previous.frequency;
+            rfBitrate = previous.bitrate;
+            rfDeviation = previous.deviation;
+            rfRxBandwidth = previous.rxBandwidth;
+            rfPreambleLen = previous.preambleLen;
+            configureRadio();
+        }
+    }
+
+    radioRetuneBlindUs = (uint32_t)(esp_timer_get_time() - start);
+    radioBlindUs += radioRetuneBlindUs;
+    radioRetuneChanged = changed;
+    radioReconfigResult = state;
+    radioReconfigPending = false;
+    if (radioReconfigRequester) xTaskNotifyGive(radioReconfigRequester);
+}
+
+// loop(): queue a config for the radio task and wait for it to be applied
+int requestRadioReconfig(const RfConfig& cfg) {
+    pendingRfConfig = cfg;
+    radioReconfigRequester = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
+    radioReconfigPending = true;
+    xTaskNotifyGive(radioTaskHandle);
+
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RADIO_RECONFIG_TIMEOUT_MS)) == 0) {
+        return RADIOLIB_ERR_UNKNOWN;
+    }
+    return radioReconfigResult;
 }
 
 // ============================================================================
@@ -698,201 +2134,1670 @@ bool initializeRadio() {
 // ============================================================================
 
 void setup() {
+#if ARDUINO_USB_MODE
+    Serial.setTxBufferSize(SERIAL_TX_BUFFER_SIZE);    // Room for several frames per USB transfer
+#endif
     Serial.begin(SERIAL_BAUD);
-    delay(1000);
+    Serial.setTxTimeoutMs(0);    // Never block on an absent host; frames go to the replay buffer instead
+    initUsbHostEvents();
+#if USB_VENDOR_LINK
+    initVendorLink();
+#endif
 
     Serial.println("\n========================================");
     Serial.println("RaptorHab Ground Station Bridge");
     Serial.println("Heltec Vision Master T190");
-    Serial.println("USB Serial Output Only");
+    Serial.println("USB Serial + BLE Output");
     Serial.println("========================================\n");
 
+    crc32Init();
+    crc16Init();
+    if (!initImageTracking()) {
+        Serial.println("[IMG] No memory for symbol bitmaps - accounting disabled");
+    }
+    if (crc32SelfTest()) {
+        Serial.printf("[CRC] Engine %d self-test passed\n", CRC32_ENGINE);
+    } else {
+        Serial.printf("[CRC] Engine %d self-test FAILED - using bitwise fallback\n", CRC32_ENGINE);
+    }
+    if (!initReplayBuffer()) {
+        Serial.println("[RPL] No PSRAM for replay buffer - packets are lost while the host is away");
+    }
+
+    // A saved config means the radio listens before the display and BLE are brought up
+    bool radioOk = true;
+    bool savedConfig = loadSavedConfig();
+    initAfc();
+    lqInit(&linkQuality, LQ_GAP_DEFAULT_MS);
+    if (savedConfig) {
+        configSource = "NVS";
+        configured = true;
+        radioOk = startRadio();
+    }
+
     pinMode(USER_BUTTON, INPUT_PULLUP);
 
     // Initialize battery monitoring pins
     pinMode(ADC_CTRL_PIN, OUTPUT);
     digitalWrite(ADC_CTRL_PIN, LOW);  // Start with divider off to save power
     analogReadResolution(12);          // 12-bit ADC (0-4095)
-    analogSetAttenuation(ADC_11db);    // Full 0-3.3V range
+    analogSetPinAttenuation(VBAT_READ_PIN, ADC_11db);  // Divider output is ~0.6-0.9V
+    xTaskCreatePinnedToCore(batteryTask, "battery", BATTERY_TASK_STACK, nullptr,
+                            BATTERY_TASK_PRIORITY, &batteryTaskHandle, BATTERY_TASK_CORE);
 
     // Initialize display
-    Serial.println("[TFT] Initializing display...");
+    logPrintf("[TFT] Initializing display...\n");
     initDisplay();
-    Serial.println("[TFT] Display initialized");
+    logPrintf("[TFT] Display initialized\n");
+
+    // BLE comes up before the CFG wait so the app can configure the modem over it
+    initBle();
+    initNet();
 
-    // Wait for configuration from USB
-    waitForConfiguration();
-    configured = true;
+    if (!savedConfig) {
+        // Wait for configuration from USB or BLE
+        waitForConfiguration();
+        configured = true;
+        radioOk = startRadio();
+    }
 
-    // Initialize radio
-    if (!initializeRadio()) {
-        Serial.println("[ERROR] Radio initialization failed!");
+    if (!radioOk) {
+        logPrintf("[ERROR] Radio initialization failed!\n");
 
-        tft->fillScreen(COLOR_BAD);
-        tft->setTextColor(COLOR_TEXT);
-        tft->setTextSize(2);
-        tft->setCursor(20, 70);
-        tft->print("RADIO INIT FAILED!");
+        gfx->fillScreen(COLOR_BAD);
+        gfx->setTextColor(COLOR_TEXT);
+        gfx->setTextSize(2);
+        gfx->setCursor(20, 70);
+        gfx->print("RADIO INIT FAILED!");
+        displayFlush();
 
         while (1) {
-            Serial.println("[ERROR] Radio init failed - please reset");
+            logPrintf("[ERROR] Radio init failed - please reset\n");
             delay(5000);
         }
     }
 
     showConfiguredScreen();
 
-    Serial.printf("\n[CONFIG] Freq:%.1f BR:%.0f Dev:%.0f BW:%.0f Preamble:%d\n",
-                  rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen);
-    Serial.println("[READY] Listening for packets...");
-    Serial.println("[USB] Packets will be forwarded via USB serial");
+    initPower();
+
+    // From here on only displayTask touches the display
+    xTaskCreatePinnedToCore(displayTask, "display", DISPLAY_TASK_STACK, nullptr,
+                            DISPLAY_TASK_PRIORITY, &displayTaskHandle, DISPLAY_TASK_CORE);
+
+    logPrintf("\n[CONFIG] Freq:%.1f BR:%.0f Dev:%.0f BW:%.0f Preamble:%d (%s)\n",
+              rfFrequency, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen, configSource);
+    logPrintf("[READY] Listening for packets...\n");
+    logPrintf("[USB] Packets will be forwarded via%s%s%s\n", ENABLE_USB ? " USB" : "",
+              ENABLE_BLE ? " BLE" : "", ENABLE_WIFI ? " Wi-Fi" : "");
 
     lastPacketTime = millis();
-    lastDisplayUpdate = millis();
-    lastStatsDisplayUpdate = millis();
+    initLoopScheduler();
+}
+
+// Start the RX tasks, then arm the radio; logs how long after reset RX was live
+bool startRadio() {
+    // Tasks must exist before DIO1 is armed so no RX-done edge is missed
+    if (!startPipeline()) {
+        logPrintf("[ERROR] Failed to start RX pipeline tasks!\n");
+        while (1) {
+            delay(5000);
+        }
+    }
+
+    if (!initializeRadio()) return false;
+    if (afcOffsetHz.load(std::memory_order_relaxed) != 0) afcRequest();     // Trim saved with AFC:
+    logPrintf("[BOOT] RX armed %lu ms after reset (config: %s)\n", millis(), configSource);
+    if (scanStartPending.load(std::memory_order_relaxed)) xTaskNotifyGive(radioTaskHandle);   // SCAN: sent while waiting for CFG
+    return true;
 }
 
 // ============================================================================
 // Main Loop
 // ============================================================================
 
-void loop() {
-    // Handle incoming packets with highest priority
-    if (packetReceived) {
-        packetReceived = false;
-        handlePacket();
-        lastPacketTime = millis();
+static void schedPollCommands() {
+    pollHostCommands();
+}
+
+static uint32_t schedClock() {
+    return micros();
+}
+
+// RX-done not yet read, or a packet in the ring the forward task has not taken
+static bool schedPacketWaiting() {
+    return dio1Pending || rxRingHead.load(std::memory_order_relaxed) != rxRingTail.load(std::memory_order_relaxed);
+}
+
+// Housekeeping runs as cooperative jobs: highest priority first, each with a
+// time budget, and a pass ends early as soon as a packet is waiting so the
+// forward task is not kept off the serial mutex
+static Scheduler loopSched;
+static SchedJob* statsJob = nullptr;
+
+void initLoopScheduler() {
+    schedInit(&loopSched, SCHED_PASS_BUDGET_US, schedClock, schedPacketWaiting);
+    schedAdd(&loopSched, "cmd", schedPollCommands, 3, SCHED_IDLE, SCHED_COMMAND_BUDGET_US);
+    statsJob = schedAdd(&loopSched, "stats", sendStats, 2, STATS_DEFAULT_INTERVAL_MS * 1000UL,
+                        SCHED_STATS_BUDGET_US);
+    schedAdd(&loopSched, "scan", scanReport, 1, SCHED_IDLE, SCHED_SCAN_BUDGET_US);
+    schedAdd(&loopSched, "power", powerUsbUpdate, 0, POWER_USB_CHECK_MS * 1000UL, SCHED_POWER_BUDGET_US);
+    statsRearm();
+}
+
+// STATS:<ms> changed the interval; from setup() also picks up one given before the scheduler existed
+void statsRearm() {
+    if (statsJob == nullptr) return;
+    statsJob->enabled = statsIntervalMs != 0;
+    if (statsJob->enabled) schedSetPeriod(&loopSched, statsJob, statsIntervalMs * 1000UL);
+}
+
+void sendSchedStatus() {
+    for (size_t i = 0; i < loopSched.count; i++) {
+        const SchedJob* job = &loopSched.jobs[loopSched.order[i]];
+        hostPrintf("[SCHED] %s pri=%u period=%lums runs=%lu max=%luus over=%lu defer=%lu forced=%lu%s\n",
+                   job->name, job->priority, job->periodUs / 1000, job->runs, job->maxUs,
+                   job->overruns, job->deferred, job->forced, job->enabled ? "" : " off");
     }
+    hostPrintf("SCHED_OK:passes=%lu yields=%lu max=%luus budget=%luus\n",
+               loopSched.passes, loopSched.yields, loopSched.maxPassUs, loopSched.passBudgetUs);
+}
+
+void loop() {
+    uint32_t start = micros();
 
-    // Send stats every 10 seconds
-    sendStats();
+    // Packets are handled by radioTask/forwardTask; loop() only does housekeeping
+    schedPass(&loopSched);
 
-    // Update display during idle periods
-    updateDisplay();
+    uint32_t elapsed = micros() - start;
+    if (elapsed > loopMaxUs) loopMaxUs = elapsed;
+
+    // A spinning loop() never lets the CPU idle, which both DFS and light sleep wait for
+    if (powerSaveEnabled) {
+        uint32_t waitMs = schedNextDueUs(&loopSched) / 1000;
+        vTaskDelay(pdMS_TO_TICKS(waitMs < POWER_LOOP_IDLE_MS ? waitMs : POWER_LOOP_IDLE_MS));
+    }
 }
 
 // ============================================================================
 // Statistics Reporting
 // ============================================================================
 
-void sendStats() {
-    if (millis() - lastStatsTime < 10000) return;
-    lastStatsTime = millis();
+// One latency histogram over the report window
+struct LatencySummary {
+    uint32_t count;
+    uint32_t avgUs;
+    uint32_t p99Us;             // Upper edge of the p99 bucket
+    uint32_t maxUs;
+};
+
+// Values that cover the time since the previous report
+struct StatsWindow {
+    uint32_t elapsedMs;
+    uint8_t rxRingHighWater;
+    uint8_t outputHighWater;
+    uint32_t replayHighWater;
+    uint32_t loopMaxUs;
+    uint32_t signalCount;       // Packets in the RSSI/SNR range, 0 = none
+    float rssiMin, rssiMean, rssiMax;
+    float snrMin, snrMean, snrMax;  // NaN when no packet had an SNR
+    LatencySummary latency[LATENCY_HISTOGRAM_COUNT];
+};
+
+// Cumulative histograms as of the previous report; the window is the difference
+struct LatencyMark {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint64_t totalUs;
+};
+
+static LatencyMark latencyMarks[LATENCY_HISTOGRAM_COUNT];
+
+// Difference against the previous report, then move the mark. A histogram cleared
+// since (LAT:RESET, a PWR: mode change) counts from zero.
+static void latencyWindowTake(LatencySummary* out) {
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_COUNT; i++) {
+        LatencyHistogram* h = latencyHistograms[i];
+        LatencyMark* mark = &latencyMarks[i];
+        LatencyMark now;
+        memcpy(now.buckets, h->buckets, sizeof(now.buckets));
+        now.totalUs = h->totalUs;
+        uint32_t windowMax = h->windowReset ? 0 : h->windowMaxUs;
+        h->windowReset = true;
+
+        bool cleared = now.totalUs < mark->totalUs;
+        uint32_t delta[LATENCY_BUCKETS];
+        uint32_t count = 0;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            if (now.buckets[b] < mark->buckets[b]) cleared = true;
+        }
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            delta[b] = cleared ? now.buckets[b] : now.buckets[b] - mark->buckets[b];
+            count += delta[b];
+        }
+        uint64_t totalUs = cleared ? now.totalUs : now.totalUs - mark->totalUs;
+        *mark = now;
+
+        out[i].count = count;
+        out[i].avgUs = count ? (uint32_t)(totalUs / count) : 0;
+        out[i].maxUs = count ? windowMax : 0;
+        out[i].p99Us = bucketPercentile(delta, count, out[i].maxUs, 99);
+    }
+}
+
+// Snapshot the current window and start the next one
+static void statsWindowTake(StatsWindow* w) {
+    static int64_t prevStatsMicros = 0;
+    int64_t nowMicros = esp_timer_get_time();
+    w->elapsedMs = (uint32_t)((nowMicros - prevStatsMicros) / 1000);
+    prevStatsMicros = nowMicros;
+
+    w->rxRingHighWater = rxRingHighWater;
+    w->outputHighWater = outputHighWater;
+    w->replayHighWater = replayHighWater;
+    w->loopMaxUs = loopMaxUs;
+    rxRingHighWater = 0;
+    outputHighWater = 0;
+    replayHighWater = replayRecords;
+    loopMaxUs = 0;
+
+    // Still set: no packet has arrived since the last report
+    w->signalCount = signalWindowReset ? 0 : signalCount;
+    uint32_t snrN = signalWindowReset ? 0 : snrCount;
+    if (w->signalCount > 0) {
+        w->rssiMin = rssiMin;
+        w->rssiMax = rssiMax;
+        w->rssiMean = rssiSum / w->signalCount;
+    } else {
+        w->rssiMin = w->rssiMean = w->rssiMax = 0.0f;
+    }
+    if (snrN > 0) {
+        w->snrMin = snrMin;
+        w->snrMax = snrMax;
+        w->snrMean = snrSum / snrN;
+    } else {
+        w->snrMin = w->snrMean = w->snrMax = NAN;
+    }
+    signalWindowReset = true;
+
+    latencyWindowTake(w->latency);
+}
+
+// PER for the [LQ] lines; "--" while the link is quiet (the seconds since are unknown) or nothing was expected
+static void lqFormatPer(char* out, size_t size, const LqCounts& c, bool quiet) {
+    if (quiet || c.good + c.lost == 0) {
+        snprintf(out, size, "--");
+    } else {
+        snprintf(out, size, "%.2f%%", lqPer(c));
+    }
+}
 
-    float rate = packetsTotal > 0 ? (100.0 * packetsForwarded / packetsTotal) : 0.0;
+static void printStats(const StatsWindow& w) {
+    float rate = packetsTotal > 0 ? (100.0 * (packetsForwarded + packetsDuplicate) / packetsTotal) : 0.0;
 
-    char statsBuf[256];
+    char statsBuf[768];
     snprintf(statsBuf, sizeof(statsBuf),
-        "\n[STATS] Total:%lu Fwd:%lu NoRAPT:%lu BadCRC:%lu Err:%lu Rate:%.1f%% Batt:%.2fV(%d%%)\n",
+        "\n[STATS] Total:%lu Fwd:%lu NoRAPT:%lu BadCRC:%lu Err:%lu Ovf:%lu(fifo:%lu late:%lu) Spur:%lu Dup:%lu Shed:%lu Rate:%.1f%% AFC:%+.1fkHz Rpl:%lu(sent:%lu drop:%lu) Inj:%lu(fwd:%lu drop:%lu) NET:%u(sent:%lu drop:%lu) BLE:%s(%lu/%lu err:%lu shed:%lu) Batt:%.2fV(%d%%)\n",
         packetsTotal, packetsForwarded, packetsRejectedNoRapt, packetsRejectedCrc,
-        packetsRadioError, rate, batteryVoltage, batteryPercent);
+        packetsRadioError, packetsRingOverflow, packetsFifoOverrun, packetsRxFollow, packetsRxSpurious, packetsDuplicate, packetsShed, rate,
+        afcAppliedHz.load() / 1000.0f, replayRecords, replayPacketsSent, replayPacketsDropped,
+        injectGenerated, injectForwarded, injectDropped,
+        netSubscriberCount, netPacketsSent, netPacketsDropped.load(),
+        bleConnected ? "Connected" : ENABLE_BLE ? "Advertising" : "Off", blePacketsSent, bleNotifications, bleNotifyErrors, bleShed,
+        batteryVoltage, batteryPercent);
+
+    int n = strlen(statsBuf);
+    n += snprintf(statsBuf + n, sizeof(statsBuf) - n, "[LAT]");
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_COUNT && n < (int)sizeof(statsBuf); i++) {
+        const LatencySummary* l = &w.latency[i];
+        n += snprintf(statsBuf + n, sizeof(statsBuf) - n, " %s:%lu/%lu/%lu/%lu",
+                      latencyHistograms[i]->name, l->count, l->avgUs, l->p99Us, l->maxUs);
+    }
+    if (n < (int)sizeof(statsBuf)) n += snprintf(statsBuf + n, sizeof(statsBuf) - n, "\n");
+
+    uint32_t now = millis();
+    LqCounts lq1 = lqSecond(&linkQuality, 1, now);
+    LqCounts lq60 = lqWindow(&linkQuality, LQ_SECONDS, now);
+    LqSignal sig;
+    lqSignal(&linkQuality, now, &sig);
+    bool quiet = lqQuiet(&linkQuality, now);
+    char per1[12], per60[12];
+    lqFormatPer(per1, sizeof(per1), lq1, quiet);
+    lqFormatPer(per60, sizeof(per60), lq60, quiet);
+    if (n < (int)sizeof(statsBuf)) {
+        snprintf(statsBuf + n, sizeof(statsBuf) - n,
+                 "[LQ] 1s:%lu/%lu 60s:%lu/%lu/%lu PER:%s/%s RSSI:%d/%d/%d Gaps:%lu(max:%lums) Quiet:%lums\n",
+                 lq1.good, lq1.lost, lq60.good, lq60.lost, lq60.bad, per1, per60,
+                 sig.rssi[0], sig.rssi[1], sig.rssi[2],
+                 linkQuality.gaps, linkQuality.longestGapMs, lqSilenceMs(&linkQuality, now));
+    }
+
+    // Never interleave with a frame being written by the forward task
+    serialLock();
     Serial.print(statsBuf);
+    serialUnlock();
+}
+
+static uint8_t* putBe16(uint8_t* p, uint16_t v) {
+    *p++ = v >> 8;
+    *p++ = v & 0xFF;
+    return p;
+}
+
+static uint8_t* putBe32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        *p++ = (v >> (24 - 8 * i)) & 0xFF;
+    }
+    return p;
+}
+
+// NaN (no value) goes out as FRAME_CDB_NONE
+static inline uint16_t toCdb(float db) {
+    return (uint16_t)frameCdb(db);
+}
+
+// Field sizes in the order they are written, README.md has the names
+#define STATS_PAYLOAD_SIZE  (1 + 1 + 4 + 4 + \
+                             1 + 4 * STATS_COUNTER_COUNT + \
+                             2 + 1 + 1 + 1 + 4 + 4 + \
+                             4 + 2 * 6 + \
+                             1 + 16 * LATENCY_HISTOGRAM_COUNT + \
+                             4 + \
+                             2 + 2 + 4 * 3 + 4 + 2 * 3 + 4 + 4 + 4 + 4)
+static_assert(STATS_PAYLOAD_SIZE <= STATS_PAYLOAD_MAX, "stats payload outgrew STATS_PAYLOAD_MAX");
+
+#define LAT_PAYLOAD_SIZE    (1 + 1 + LATENCY_HISTOGRAM_COUNT * (12 + 4 * LATENCY_BUCKETS))
+static_assert(LAT_PAYLOAD_SIZE <= LAT_PAYLOAD_MAX, "histogram payload outgrew LAT_PAYLOAD_MAX");
+
+// One FRAME_STATS_TAG frame, layout in README.md; no float formatting, dropped if USB is full
+static void sendStatsFrame(const StatsWindow& w) {
+    static uint8_t payload[STATS_PAYLOAD_MAX];
+    static uint8_t frame[FRAME_TAGGED_MAX_SIZE(STATS_PAYLOAD_MAX)];
+    uint8_t* p = payload;
+
+    *p++ = STATS_FRAME_VERSION;
+    *p++ = (bleConnected ? 0x01 : 0) | (usbHostAway ? 0x02 : 0) |
+           (injectRate > 0 ? 0x04 : 0) | (configured ? 0x08 : 0) |
+           (lqQuiet(&linkQuality, millis()) ? 0x10 : 0);
+    p = putBe32(p, millis());
+    p = putBe32(p, w.elapsedMs);
+
+    const uint32_t counters[] = {
+        packetsTotal, packetsForwarded, packetsRejectedNoRapt, packetsRejectedCrc,
+        packetsRadioError, packetsRingOverflow, packetsDuplicate, packetsShed,
+        replayRecords, replayPacketsStored, replayPacketsSent, replayPacketsDropped,
+        injectGenerated, injectForwarded, injectDropped,
+        blePacketsSent, bleNotifications, bleNotifyErrors, bleShed,
+        radioBlindUs, statsFramesSkipped, netPacketsSent, netPacketsDropped.load(),
+        packetsFifoOverrun, packetsRxFollow
+    };
+    static_assert(sizeof(counters) / sizeof(counters[0]) == STATS_COUNTER_COUNT, "update STATS_COUNTER_COUNT");
+    *p++ = STATS_COUNTER_COUNT;
+    for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+        p = putBe32(p, counters[i]);
+    }
+
+    p = putBe16(p, (uint16_t)lroundf(batteryVoltage * 1000.0f));
+    *p++ = (uint8_t)batteryPercent;
+    *p++ = w.rxRingHighWater;
+    *p++ = w.outputHighWater;
+    p = putBe32(p, w.replayHighWater);
+    p = putBe32(p, w.loopMaxUs);
+
+    p = putBe32(p, w.signalCount);
+    p = putBe16(p, toCdb(w.rssiMin));
+    p = putBe16(p, toCdb(w.rssiMean));
+    p = putBe16(p, toCdb(w.rssiMax));
+    p = putBe16(p, toCdb(w.snrMin));
+    p = putBe16(p, toCdb(w.snrMean));
+    p = putBe16(p, toCdb(w.snrMax));
+
+    // Window summaries only; LAT:BIN sends the full histograms
+    *p++ = LATENCY_HISTOGRAM_COUNT;
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_COUNT; i++) {
+        p = putBe32(p, w.latency[i].count);
+        p = putBe32(p, w.latency[i].avgUs);
+        p = putBe32(p, w.latency[i].p99Us);
+        p = putBe32(p, w.latency[i].maxUs);
+    }
+
+    p = putBe32(p, (uint32_t)afcAppliedHz.load());
+
+    uint32_t now = millis();
+    LqCounts lq1 = lqSecond(&linkQuality, 1, now);
+    LqCounts lq60 = lqWindow(&linkQuality, LQ_SECONDS, now);
+    LqSignal sig;
+    lqSignal(&linkQuality, now, &sig);
+    p = putBe16(p, (uint16_t)lq1.good);
+    p = putBe16(p, (uint16_t)lq1.lost);
+    p = putBe32(p, lq60.good);
+    p = putBe32(p, lq60.lost);
+    p = putBe32(p, lq60.bad);
+    p = putBe32(p, sig.count);
+    for (int i = 0; i < 3; i++) p = putBe16(p, toCdb(sig.rssi[i]));
+    p = putBe32(p, linkQuality.gaps);
+    p = putBe32(p, linkQuality.longestGapMs);
+    p = putBe32(p, lqSilenceMs(&linkQuality, now));
+    p = putBe32(p, linkQuality.resyncs);
+
+    size_t frameLen = buildTaggedFrame(frame, FRAME_STATS_TAG, payload, p - payload);
+
+    // Same rule as packet frames on the CDC port
+    serialLock();
+    bool sent = serialWriteFrame(frame, frameLen) == frameLen;
+    serialUnlock();
+    if (!sent) statsFramesSkipped++;
+}
+
+void reportStats(uint8_t format) {
+    StatsWindow w;
+    statsWindowTake(&w);
+    if (format & STATS_FORMAT_TEXT) printStats(w);
+    if (format & STATS_FORMAT_BINARY) sendStatsFrame(w);
+}
+
+// Periodic report, run by the loop scheduler every statsIntervalMs
+void sendStats() {
+    reportStats(statsFormat);
+}
+
+static const char* statsFormatName(uint8_t format) {
+    if (format == (STATS_FORMAT_TEXT | STATS_FORMAT_BINARY)) return "BOTH";
+    return format == STATS_FORMAT_BINARY ? "BIN" : "TEXT";
+}
+
+// STATS:<ms> sets the report interval (0 = off), STATS:TEXT/BIN/BOTH the format
+void handleStatsCommand(const char* arg) {
+    if (strcmp(arg, "TEXT") == 0) {
+        statsFormat = STATS_FORMAT_TEXT;
+    } else if (strcmp(arg, "BIN") == 0) {
+        statsFormat = STATS_FORMAT_BINARY;
+    } else if (strcmp(arg, "BOTH") == 0) {
+        statsFormat = STATS_FORMAT_TEXT | STATS_FORMAT_BINARY;
+    } else {
+        char* end;
+        unsigned long ms = strtoul(arg, &end, 10);
+        if (end == arg || *end != '\0' ||
+            (ms != 0 && (ms < STATS_MIN_INTERVAL_MS || ms > STATS_MAX_INTERVAL_MS))) {
+            hostPrintf("STATS_ERR:Interval must be 0 or %d-%d ms\n",
+                       STATS_MIN_INTERVAL_MS, STATS_MAX_INTERVAL_MS);
+            return;
+        }
+        statsIntervalMs = ms;
+        statsRearm();
+    }
+    hostPrintf("STATS_OK:interval=%lu fmt=%s\n", statsIntervalMs, statsFormatName(statsFormat));
+}
+
+// LQ:GAP:<ms> sets the gap threshold, LQ:RESET clears the history
+void handleLqCommand(const char* arg) {
+    if (strcmp(arg, "RESET") == 0) {
+        lqResetPending = true;
+        if (forwardTaskHandle) xTaskNotifyGive(forwardTaskHandle);
+        hostPrintf("LQ_OK\n");
+        return;
+    }
+    if (strncmp(arg, "GAP:", 4) != 0) {
+        hostPrintf("LQ_ERR:Use LQ:GAP:<ms> or LQ:RESET\n");
+        return;
+    }
+    char* end;
+    unsigned long ms = strtoul(arg + 4, &end, 10);
+    if (end == arg + 4 || *end != '\0' || ms < LQ_GAP_MIN_MS || ms > LQ_GAP_MAX_MS) {
+        hostPrintf("LQ_ERR:Gap must be %d-%d ms\n", LQ_GAP_MIN_MS, LQ_GAP_MAX_MS);
+        return;
+    }
+    linkQuality.gapThresholdMs = ms;    // One aligned word, read by the forward task
+    hostPrintf("LQ_OK:gap=%lums\n", ms);
+}
+
+void sendLqStatus() {
+    uint32_t now = millis();
+    LqCounts lq1 = lqSecond(&linkQuality, 1, now);
+    LqCounts lq60 = lqWindow(&linkQuality, LQ_SECONDS, now);
+    LqSignal sig;
+    lqSignal(&linkQuality, now, &sig);
+    bool quiet = lqQuiet(&linkQuality, now);
+    char per1[12], per60[12];
+    lqFormatPer(per1, sizeof(per1), lq1, quiet);
+    lqFormatPer(per60, sizeof(per60), lq60, quiet);
+    hostPrintf("[LQ] 1s:%lu/%lu 60s:%lu/%lu/%lu PER:%s/%s\n",
+               lq1.good, lq1.lost, lq60.good, lq60.lost, lq60.bad, per1, per60);
+    hostPrintf("[LQ] RSSI:%d/%d/%d n=%lu\n", sig.rssi[0], sig.rssi[1], sig.rssi[2], sig.count);
+
+    // Per-minute PER, oldest first, ending with the last complete minute
+    char line[96];
+    int n = snprintf(line, sizeof(line), "[LQ] min:");
+    for (int ago = LQ_MINUTES_REPORTED; ago >= 1 && n < (int)sizeof(line); ago--) {
+        n += snprintf(line + n, sizeof(line) - n, ago > 1 ? "%.1f," : "%.1f", lqPer(lqMinute(&linkQuality, ago, now)));
+    }
+    hostPrintf("%s\n", line);
+
+    hostPrintf("LQ_OK:gaps=%lu max=%lums quiet=%lums resync=%lu gap=%lums\n",
+               linkQuality.gaps, linkQuality.longestGapMs, lqSilenceMs(&linkQuality, now),
+               linkQuality.resyncs, linkQuality.gapThresholdMs);
+}
+
+// Full histogram dump, one line per stage: count, mean, p50/p99 bucket edge, max, buckets
+// LAT:BIN: one FRAME_LAT_TAG frame with every histogram since LAT:RESET
+void sendLatencyFrame() {
+    static uint8_t payload[LAT_PAYLOAD_MAX];
+    static uint8_t frame[FRAME_TAGGED_MAX_SIZE(LAT_PAYLOAD_MAX)];
+    uint8_t* p = payload;
+
+    *p++ = LATENCY_HISTOGRAM_COUNT;
+    *p++ = LATENCY_BUCKETS;
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_COUNT; i++) {
+        const LatencyHistogram* h = latencyHistograms[i];
+        p = putBe32(p, h->count);
+        p = putBe32(p, h->count ? (uint32_t)(h->totalUs / h->count) : 0);
+        p = putBe32(p, h->maxUs);
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            p = putBe32(p, h->buckets[b]);
+        }
+    }
+
+    size_t frameLen = buildTaggedFrame(frame, FRAME_LAT_TAG, payload, p - payload);
+    serialLock();
+    bool sent = serialWriteFrame(frame, frameLen) == frameLen;
+    serialUnlock();
+    if (sent) {
+        hostPrintf("LAT_OK\n");
+    } else {
+        hostPrintf("LAT_ERR:USB TX full, try again\n");
+    }
+}
+
+void sendLatencyReport() {
+    serialLock();
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_COUNT; i++) {
+        const LatencyHistogram* h = latencyHistograms[i];
+        Serial.printf("[LAT] %s n=%lu avg=%lu p50<=%lu p99<=%lu max=%lu us b=",
+                      h->name, h->count, h->count ? (uint32_t)(h->totalUs / h->count) : 0,
+                      latencyPercentile(h, 50), latencyPercentile(h, 99), h->maxUs);
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            Serial.printf(b ? ",%lu" : "%lu", h->buckets[b]);
+        }
+        Serial.println();
+    }
+    serialUnlock();
+}
+
+// ============================================================================
+// RX Pipeline Tasks
+// ============================================================================
+
+bool startPipeline() {
+    serialMutex = xSemaphoreCreateMutex();
+    if (serialMutex == nullptr) return false;
+    outputInit();
+
+    if (xTaskCreatePinnedToCore(forwardTask, "forward", FORWARD_TASK_STACK, nullptr,
+                                FORWARD_TASK_PRIORITY, &forwardTaskHandle, FORWARD_TASK_CORE) != pdPASS) {
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(radioTask, "radio", RADIO_TASK_STACK, nullptr,
+                                RADIO_TASK_PRIORITY, &radioTaskHandle, RADIO_TASK_CORE) != pdPASS) {
+        return false;
+    }
+    return true;
+}
+
+void radioTask(void* param) {
+    TickType_t wait = portMAX_DELAY;
+    for (;;) {
+        // Woken by onPacketReceived(), a runtime CFG, INJ: or SCAN:; a count > 1 still means one RX-done.
+        // While injecting, also every tick to generate the packets that have come due,
+        // and while scanning every SCAN_SAMPLE_MS to poll the IRQ flags and RSSI.
+        // In light sleep, bounded so an RX-done edge lost to a sleep transition is still noticed.
+        if (powerLightSleep && wait > pdMS_TO_TICKS(POWER_DIO1_POLL_MS)) wait = pdMS_TO_TICKS(POWER_DIO1_POLL_MS);
+        if (ulTaskNotifyTake(pdTRUE, wait) == 0 && powerCheckLostEdge()) dio1Pending = true;
+        if (dio1Pending) {
+            dio1Pending = false;
+            handlePacket();
+        }
+        if (radioReconfigPending) {
+            scanAbort();                    // A CFG: overrides whatever the scan was trying
+            applyPendingRadioConfig();
+            afcRadioRetuned();
+            injectUpdatePending = true;     // Back to standby if the injector had the radio off
+        }
+        TickType_t afcWait = afcService();
+        TickType_t scanWait = scanService();
+        wait = injectService();
+        if (scanWait < wait) wait = scanWait;
+        if (afcWait < wait) wait = afcWait;
+    }
+}
+
+void forwardTask(void* param) {
+    for (;;) {
+        // With output pending, wake regularly to keep draining it while the radio is quiet.
+        // A host that went away is waited for: a CDC event or the next packet wakes the task.
+        bool pending = !usbHostAway && (replayRecords > 0 || outputQueued() > 0);
+        TickType_t idle = imageAwaitingSymbols() ? pdMS_TO_TICKS(IMAGE_FAIL_IDLE_MS) : portMAX_DELAY;
+        ulTaskNotifyTake(pdTRUE, pending ? pdMS_TO_TICKS(REPLAY_IDLE_POLL_MS) : idle);
+
+        if (replayClearRequested) {
+            replayClear();
+            replayClearRequested = false;
+        }
+        if (lqResetPending) {
+            lqInit(&linkQuality, linkQuality.gapThresholdMs);
+            lqResetPending = false;
+        }
+        if (latRxToForwardResetPending) {
+            latencyClear(&latRxToForward);
+            latRxToForwardResetPending = false;
+        }
+
+        RxSlot* slot;
+        while ((slot = rxRingPeek()) != nullptr) {
+            processPacket(slot);
+            rxRingRelease();
+        }
+
+        // Ring drained: send whatever BLE batch has built up rather than wait for more
+        imageService();
+        bleService();
+
+        // Push out whatever the USB link can take now, queued frames first
+        outputService();
+        usbFlush();
+    }
 }
 
 // ============================================================================
 // Packet Handling
 // ============================================================================
 
+// Make DIO1 ready for the next packet. In continuous RX the SX1262 is already
+// searching for the next preamble and only the IRQ flags are cleared. In single
+// mode it has dropped to standby at RX-done and SetRx puts it back in RX. Either is one or two raw commands instead of
+// startReceive(), which rewrites DIO routing and buffer addresses that are
+// already set, and is only used as the fallback when a command fails.
+// deafSince: when the radio stopped listening (the RX-done edge in single mode).
+static int rxRearm(int64_t deafSince) {
+    Module* mod = radio->getMod();
+    int64_t start = esp_timer_get_time();
+    uint8_t clear[2] = { (uint8_t)(RADIOLIB_SX126X_IRQ_ALL >> 8), (uint8_t)(RADIOLIB_SX126X_IRQ_ALL & 0xFF) };
+    int state = mod->SPIwriteStream(RADIOLIB_SX126X_CMD_CLEAR_IRQ_STATUS, clear, 2);
+#if !RX_CONTINUOUS
+    if (state == RADIOLIB_ERR_NONE) {
+        uint8_t timeout[3] = { rxSetRxTimeout[0], rxSetRxTimeout[1], rxSetRxTimeout[2] };
+        state = mod->SPIwriteStream(RADIOLIB_SX126X_CMD_SET_RX, timeout, 3);
+    }
+#endif
+    bool restarted = state != RADIOLIB_ERR_NONE;
+    if (restarted) state = rxStartReceive();
+
+    int64_t now = esp_timer_get_time();
+#if RX_CONTINUOUS
+    (void)deafSince;
+    if (restarted) radioBlindUs += (uint32_t)(now - start);
+#else
+    (void)start;
+    radioBlindUs += (uint32_t)(now - deafSince);
+#endif
+    return state;
+}
+
+// Single mode: SetRx restarts writing the FIFO from the base address, but only after the next
+// preamble and sync word. Re-arm before reading the payload if that lead time
+// covers the readout (~0.5 us/byte at 16 MHz plus per-transaction overhead).
+static inline bool rxRearmBeforeRead(int packetLen) {
+    float leadUs = (rfPreambleLen + SYNC_WORD_LEN * 8) * 1000.0f / rfBitrate;
+    float readoutUs = 50.0f + packetLen * 8 * 1e6f / LORA_SPI_FREQ;
+    return leadUs > 2.0f * readoutUs;
+}
+
+#if RX_CONTINUOUS
+// Continuous mode: the packet after this one is written behind it in the 256-byte
+// circular FIFO and reaches its first byte after its own preamble and sync word
+// plus 256 - len payload bytes. A read that starts earlier, counted from when this
+// packet can have ended, always stays ahead of the writer.
+static inline bool rxReadOutrun(int packetLen, int64_t endedMicros, int64_t readStartMicros) {
+    float safeUs = (rfPreambleLen + SYNC_WORD_LEN * 8 + (RX_FIFO_SIZE - packetLen) * 8) * 1000.0f / rfBitrate;
+    return (float)(readStartMicros - endedMicros) > safeUs;
+}
+#endif
+
+// GetIrqStatus; onError is returned when the SPI read fails
+static uint16_t rxIrqStatus(Module* mod, uint16_t onError = 0) {
+    uint8_t irq[2] = { 0, 0 };
+    if (mod->SPIreadStream(RADIOLIB_SX126X_CMD_GET_IRQ_STATUS, irq, 2) != RADIOLIB_ERR_NONE) return onError;
+    return ((uint16_t)irq[0] << 8) | irq[1];
+}
+
+// Radio task: drain the SX1262 into the ring and re-arm RX as fast as possible.
+// Raw SX126x commands: GetRxBufferStatus, GetPacketStatus, ReadBuffer from
+// RxStartBufferPointer, ClearIrqStatus (+ SetRx in single mode), after
+// GetIrqStatus has confirmed RX-done: a stale notification or a glitch on DIO1
+// would otherwise read the last packet out of the FIFO again. Continuous RX
+// reads the payload before clearing the IRQ: the radio is listening either way,
+// and the packet behind this one overwrites it in the FIFO, so the readout
+// goes first. Every exit goes through rxRearm().
 void handlePacket() {
-    uint8_t packet[MAX_PACKET_SIZE];
-    
-    int packetLen = radio->getPacketLength();
-    if (packetLen <= 0 || packetLen > MAX_PACKET_SIZE) {
-        radio->startReceive();
+    int64_t rxMicros = dio1Micros;
+    Module* mod = radio->getMod();
+
+    // RX-done not latched: nothing to clear, and the radio is still listening.
+    // A failed read goes on as RX-done; the buffer status read below decides.
+    if ((rxIrqStatus(mod, RADIOLIB_SX126X_IRQ_RX_DONE) & RADIOLIB_SX126X_IRQ_RX_DONE) == 0) {
+        packetsRxSpurious++;
         return;
     }
-    
-    int state = radio->readData(packet, packetLen);
-    lastRssi = radio->getRSSI();
-    lastSnr = radio->getSNR();
-    packetsTotal++;
-    
-    // IMMEDIATELY restart receive
-    radio->startReceive();
-    
-    if (state != RADIOLIB_ERR_NONE) {
-        packetsRadioError++;
+
+#if RX_CONTINUOUS
+    // From here on a preamble or sync word belongs to the packet behind this one;
+    // RX-done stays set, so DIO1 is not re-armed yet
+    uint8_t clearSync[2] = { 0, RADIOLIB_SX126X_IRQ_PREAMBLE_DETECTED | RADIOLIB_SX126X_IRQ_SYNC_WORD_VALID };
+    mod->SPIwriteStream(RADIOLIB_SX126X_CMD_CLEAR_IRQ_STATUS, clearSync, 2);
+#endif
+
+    for (int follow = 0; ; follow++) {
+        int64_t readMicros = esp_timer_get_time();
+        uint8_t bufferStatus[2];    // PayloadLengthRx, RxStartBufferPointer
+        uint8_t packetStatus[3];    // RxStatus, RssiSync, RssiAvg (GFSK)
+        int state = mod->SPIreadStream(RADIOLIB_SX126X_CMD_GET_RX_BUFFER_STATUS, bufferStatus, 2);
+        if (state == RADIOLIB_ERR_NONE) {
+            state = mod->SPIreadStream(RADIOLIB_SX126X_CMD_GET_PACKET_STATUS, packetStatus, 3);
+        }
+        int packetLen = bufferStatus[0];
+        if (state != RADIOLIB_ERR_NONE || packetLen <= 0 || packetLen > MAX_PACKET_SIZE) {
+            rxRearm(rxMicros);
+            if (state != RADIOLIB_ERR_NONE) packetsRadioError++;
+            return;
+        }
+#if RX_CONTINUOUS
+        // Already read as the follow-up of the previous packet; this is its late DIO1 edge
+        if (follow == 0 && rxFollowTaken == bufferStatus[1] && rxMicros <= rxFollowMicros) {
+            rxFollowTaken = -1;
+            rxRearm(rxMicros);
+            return;
+        }
+        rxFollowTaken = -1;
+#endif
+
+        // With the ring full the FIFO is still drained so the radio keeps receiving
+        uint8_t overflow[MAX_PACKET_SIZE];
+        RxSlot* slot = rxRingAcquire();
+        uint8_t* packet = slot ? slot->data : overflow;
+
+        // RssiAvg, as RadioLib's getRSSI(); GFSK has no SNR
+        lastRssi = -(float)packetStatus[2] / 2.0f;
+        lastSnr = NAN;
+        signalRecord(lastRssi, lastSnr);
+        packetsTotal++;
+        lastPacketTime = millis();
+
+#if RX_CONTINUOUS
+        bool rearmFirst = false;
+#else
+        bool rearmFirst = rxRearmBeforeRead(packetLen);
+#endif
+        if (rearmFirst) {
+            rxRearm(rxMicros);
+            latencyRecord(&latReadToRearm, esp_timer_get_time() - readMicros);
+        }
+
+        int64_t readStartMicros = esp_timer_get_time();
+        uint8_t readCmd[2] = { RADIOLIB_SX126X_CMD_READ_BUFFER, bufferStatus[1] };
+        state = mod->SPIreadStream(readCmd, 2, packet, packetLen);
+
+#if RX_CONTINUOUS
+        // A sync word since the flags were cleared and a late read: the next packet got here first.
+        // If the flags were cleared too late to see that sync word, the CRC32 decides.
+        bool overrun = rxReadOutrun(packetLen, rxMicros, readStartMicros) &&
+                       (rxIrqStatus(mod) & RADIOLIB_SX126X_IRQ_SYNC_WORD_VALID) != 0;
+#else
+        (void)readStartMicros;
+#endif
+
+        if (!rearmFirst) {
+            rxRearm(rxMicros);
+            latencyRecord(&latReadToRearm, esp_timer_get_time() - readMicros);
+        }
+        if (follow == 0) latencyRecord(&latIsrToRead, readMicros - rxMicros);
+
+        bool deliver = true;
+        if (state != RADIOLIB_ERR_NONE) {
+            packetsRadioError++;
+            deliver = false;
+#if RX_CONTINUOUS
+        } else if (overrun) {
+            packetsFifoOverrun++;
+            deliver = false;
+#endif
+        } else if (slot == nullptr) {
+            packetsRingOverflow++;
+            deliver = false;
+        }
+
+        if (deliver) {
+            slot->rxMicros = rxMicros;
+            slot->len = packetLen;
+            slot->rssi = lastRssi;
+            slot->snr = lastSnr;
+            slot->injected = false;
+            rxRingPublish();
+            xTaskNotifyGive(forwardTaskHandle);
+        }
+
+#if !RX_CONTINUOUS
         return;
+#else
+        // A packet that ended before the ClearIrqStatus above lost its DIO1 edge to it;
+        // a new start pointer shows it is in the FIFO, complete
+        uint8_t nextStatus[2];
+        if (follow >= RX_FOLLOW_MAX ||
+            mod->SPIreadStream(RADIOLIB_SX126X_CMD_GET_RX_BUFFER_STATUS, nextStatus, 2) != RADIOLIB_ERR_NONE ||
+            nextStatus[1] == bufferStatus[1]) {
+            return;
+        }
+        // It may also have raised DIO1 after the clear; that edge finds this pointer and only re-arms
+        rxFollowTaken = nextStatus[1];
+        rxFollowMicros = esp_timer_get_time();
+        packetsRxFollow++;
+        rxMicros = readMicros;              // Earliest it can have ended
+#endif
     }
-    
-    // Validate packet starts with "RAPT"
-    if (packetLen < 12 || 
-        packet[0] != 0x52 || packet[1] != 0x41 || 
-        packet[2] != 0x50 || packet[3] != 0x54) {
+}
+
+// Forward task: validate a ring slot and forward it to the host
+// "RAPT" and the minimum length, CRC32 trailer with the engine chosen by CRC32_ENGINE,
+// image data to the bulk class; see raptor_pipeline.h
+typedef RaptorValidator<crc32> PacketValidator;
+
+void processPacket(const RxSlot* slot) {
+    const uint8_t* packet = slot->data;
+    int packetLen = slot->len;
+    int64_t validateStart = esp_timer_get_time();
+    latencyRecord(&latRxToForward, validateStart - slot->rxMicros);
+
+    uint8_t outputClass = OUTPUT_CLASS_PRIORITY;
+    PipeVerdict verdict = PacketValidator::validate(packet, packetLen, &outputClass);
+    if (verdict == PIPE_REJECT_SYNC) {
         packetsRejectedNoRapt++;
         return;
     }
-    
-    // Validate CRC32
-    uint32_t receivedCrc = ((uint32_t)packet[packetLen-4] << 24) |
-                           ((uint32_t)packet[packetLen-3] << 16) |
-                           ((uint32_t)packet[packetLen-2] << 8) |
-                           ((uint32_t)packet[packetLen-1]);
-    uint32_t calculatedCrc = crc32(packet, packetLen - 4);
-    
-    if (receivedCrc != calculatedCrc) {
+    uint32_t rxMs = (uint32_t)(slot->rxMicros / 1000);
+    if (verdict == PIPE_REJECT_CHECK) {
         packetsRejectedCrc++;
+        if (!slot->injected) lqRecordBad(&linkQuality, rxMs);
+        return;
+    }
+    latencyRecord(&latValidate, esp_timer_get_time() - validateStart);
+
+    // Before dedup, so a repeated symbol still counts as heard
+    if (!slot->injected && lqRecordPacket(&linkQuality, readBe16(packet + 5), slot->rssi, rxMs)) {
+        logPrintf("[LQ] Gap %lu ms, %lu lost\n", linkQuality.lastGapMs, linkQuality.lastGapLost);
+    }
+
+    // Also before dedup: the bitmap sees every copy of a symbol and counts the repeats itself
+    uint8_t type = packet[PIPE_TYPE_OFFSET];
+    bool imagePacket = type == PKT_TYPE_IMAGE_META || type == PKT_TYPE_IMAGE_DATA;
+    if (imagePacket && !slot->injected && imageTrackingEnabled) trackImagePacket(packet, packetLen);
+
+    if (dedupEnabled && isDuplicatePacket(packet, packetLen)) {
+        packetsDuplicate++;
         return;
     }
     
-    // Valid packet - forward via USB
-    forwardPacket(packet, packetLen, lastRssi, lastSnr);
+    // Valid packet - offer it to every output sink; image symbols are the class shed under backpressure
+    bool imageRebuilt = outputClass == OUTPUT_CLASS_BULK && !slot->injected &&
+                        imageTrackingEnabled && imageSymbolRedundant(packet, packetLen);
+    sinkPublish(slot, outputClass, imageRebuilt);
+
+    // Injected packets are kept out of the radio counters, the scan and image accounting
+    if (slot->injected) {
+        injectForwarded++;
+        return;
+    }
     packetsForwarded++;
+    scanRecord(slot);
     
-    // Track by size
-    if (packetLen < 100) {
-        packetsSmall++;
+    // Track by type
+    if (type == PKT_TYPE_TELEMETRY) {
+        packetsTelemetry++;
+    } else if (imagePacket) {
+        packetsImage++;
+    }
+}
+
+// ============================================================================
+// Synthetic Packet Injector
+// ============================================================================
+//
+// Runs in the radio task, so the RX ring keeps a single producer. Packets are
+// valid RaptorHAB frames and go through the same validation, dedup and output
+// path as received ones.
+
+// Radio task state
+static uint32_t injectActiveRate = 0;
+static uint8_t injectActiveMinLen = INJECT_DEFAULT_MIN_LEN;
+static uint8_t injectActiveMaxLen = INJECT_DEFAULT_MAX_LEN;
+static int64_t injectStartMicros = 0;
+static uint64_t injectIssued = 0;       // Packets due so far in this run, generated or dropped
+static bool injectRadioStopped = false;
+static int64_t injectRadioStoppedSince = 0;
+
+static void injectBuildPacket(RxSlot* slot, int64_t now) {
+    static uint32_t lcg = 0x2545F491;
+    static uint16_t seq = 0;
+    static uint32_t symbolId = 0;
+
+    lcg = lcg * 1664525 + 1013904223;
+    int len = injectActiveMinLen + (lcg >> 16) % (injectActiveMaxLen - injectActiveMinLen + 1);
+    bool image = len >= INJECT_IMAGE_MIN_LEN;
+
+    uint8_t* p = slot->data;
+    memcpy(p, SYNC_WORD, SYNC_WORD_LEN);
+    p[4] = image ? PKT_TYPE_IMAGE_DATA : PKT_TYPE_TELEMETRY;
+    p[5] = seq >> 8;
+    p[6] = seq & 0xFF;
+    p[7] = 0;                           // FLAGS
+    seq++;
+
+    int i = PKT_HEADER_SIZE;
+    if (image) {
+        p[i++] = INJECT_IMAGE_ID >> 8;
+        p[i++] = INJECT_IMAGE_ID & 0xFF;
+        for (int b = 0; b < 4; b++) {
+            p[i++] = (symbolId >> (24 - 8 * b)) & 0xFF;
+        }
+        symbolId++;
+    }
+    for (; i < len - 4; i++) {
+        lcg = lcg * 1664525 + 1013904223;
+        p[i] = lcg >> 24;
+    }
+
+    uint32_t crc = crc32(p, len - 4);
+    p[len - 4] = crc >> 24;
+    p[len - 3] = (crc >> 16) & 0xFF;
+    p[len - 2] = (crc >> 8) & 0xFF;
+    p[len - 1] = crc & 0xFF;
+
+    slot->rxMicros = now;
+    slot->len = len;
+    slot->rssi = 0.0f;
+    slot->snr = NAN;
+    slot->injected = true;
+}
+
+static void injectApplyPending() {
+    injectUpdatePending = false;
+    injectActiveRate = injectRate;
+    injectActiveMinLen = injectMinLen;
+    injectActiveMaxLen = injectMaxLen;
+    int64_t now = esp_timer_get_time();
+    injectStartMicros = now;
+    injectIssued = 0;
+
+    // standby() is repeated after a runtime CFG, which leaves the radio in RX
+    bool stop = injectActiveRate > 0 && injectRadioOff && radio != nullptr;
+    if (stop) {
+        radio->standby();
+        if (!injectRadioStopped) injectRadioStoppedSince = now;
+        injectRadioStopped = true;
+    } else if (injectRadioStopped) {
+        rxStartReceive();
+        radioBlindUs += (uint32_t)(now - injectRadioStoppedSince);
+        injectRadioStopped = false;
+    }
+}
+
+// Radio task: generate every packet due at the configured rate; returns the next wait
+TickType_t injectService() {
+    if (injectUpdatePending) injectApplyPending();
+    if (injectActiveRate == 0) return portMAX_DELAY;
+
+    int64_t now = esp_timer_get_time();
+    uint64_t due = (uint64_t)(now - injectStartMicros) * injectActiveRate / 1000000;
+    uint32_t burst = 0;
+    while (injectIssued < due && burst < INJECT_BURST_MAX) {
+        injectIssued++;
+        burst++;
+        // A full ring means the forward path is the bottleneck; count it like a radio overflow
+        RxSlot* slot = rxRingAcquire();
+        if (slot == nullptr) {
+            injectDropped++;
+            continue;
+        }
+        injectBuildPacket(slot, now);
+        rxRingPublish();
+        injectGenerated++;
+    }
+    if (burst > 0) xTaskNotifyGive(forwardTaskHandle);
+    return 1;
+}
+
+// INJ:<rate>[,<minLen>,<maxLen>[,<radio>]]; lengths are picked uniformly in [min, max]
+void handleInjectCommand(const char* args) {
+    char* end;
+    unsigned long rate = strtoul(args, &end, 10);
+    unsigned long minLen = INJECT_DEFAULT_MIN_LEN;
+    unsigned long maxLen = INJECT_DEFAULT_MAX_LEN;
+    unsigned long radioOn = 1;
+    bool ok = end != args;
+    if (ok && *end == ',') {
+        minLen = strtoul(end + 1, &end, 10);
+        ok = *end == ',';
+        if (ok) maxLen = strtoul(end + 1, &end, 10);
+        if (ok && *end == ',') radioOn = strtoul(end + 1, &end, 10);
+    }
+    if (!ok || *end != '\0') {
+        hostPrintf("INJ_ERR:Expected <rate>[,<min>,<max>[,<radio>]]\n");
+        return;
+    }
+    if (rate > INJECT_MAX_RATE) {
+        hostPrintf("INJ_ERR:Rate must be 0-%d\n", INJECT_MAX_RATE);
+        return;
+    }
+    if (minLen < PKT_MIN_SIZE || maxLen > MAX_PACKET_SIZE || minLen > maxLen) {
+        hostPrintf("INJ_ERR:Length must be %d-%d\n", PKT_MIN_SIZE, MAX_PACKET_SIZE);
+        return;
+    }
+    if (radioTaskHandle == nullptr) {
+        hostPrintf("INJ_ERR:Radio task not running\n");
+        return;
+    }
+    if (rate > 0 && radioOn == 0 && (scanActive.load(std::memory_order_relaxed) || scanStartPending.load(std::memory_order_relaxed))) {
+        hostPrintf("INJ_ERR:Scan in progress\n");
+        return;
+    }
+
+    injectMinLen = minLen;
+    injectMaxLen = maxLen;
+    injectRadioOff = radioOn == 0;
+    injectRate = rate;
+    injectUpdatePending = true;
+    xTaskNotifyGive(radioTaskHandle);
+    hostPrintf("INJ_OK:rate=%lu len=%lu-%lu radio=%d\n", rate, minLen, maxLen, radioOn ? 1 : 0);
+}
+
+void sendInjectStatus() {
+    hostPrintf("INJ_OK:rate=%lu len=%u-%u radio=%d gen=%lu fwd=%lu drop=%lu\n",
+               injectRate, injectMinLen, injectMaxLen, injectRadioOff ? 0 : 1,
+               injectGenerated, injectForwarded, injectDropped);
+}
+
+// ============================================================================
+// Frequency Tracking (AFC)
+// ============================================================================
+//
+// The SX1262 gives no frequency error estimate in GFSK mode (RadioLib's
+// getFrequencyError() is LoRa-only), and between bursts its RSSI only measures
+// noise, so the offset cannot be measured without moving the receiver off the
+// carrier during traffic. What is left is a trim: the host (or an operator
+// following the balloon's drift) sets an offset from rfFrequency with AFC:,
+// and the radio task applies it in a gap between packets. SCAN: finds a
+// carrier when it has moved too far for that. The radio task is the only
+// SX1262 user and retunes only while no preamble or sync word is latched, so
+// a packet in flight is not cut off.
+
+// Ask the radio task to move to afcOffsetHz
+void afcRequest() {
+    afcRetunePending.store(true, std::memory_order_release);
+    if (radioTaskHandle) xTaskNotifyGive(radioTaskHandle);
+}
+
+// loop(): set the trim and optionally keep it for the next boot
+static void afcSetTrim(int32_t offsetHz, bool save) {
+    bool changed = offsetHz != afcOffsetHz.load(std::memory_order_relaxed);
+    afcOffsetHz.store(offsetHz, std::memory_order_relaxed);
+    if (changed) afcRequest();
+    if (save && prefs.begin(NVS_NAMESPACE, false)) {
+        prefs.putInt(NVS_KEY_AFC_TRIM, offsetHz);
+        prefs.end();
+    }
+}
+
+// Standby on the crystal (no TCXO restart), SetRfFrequency, SetRx: far shorter than startReceive()
+static int afcTune(int32_t offsetHz) {
+    Module* mod = radio->getMod();
+    double mhz = rfFrequency + offsetHz / 1e6;
+    uint32_t frf = (uint32_t)(mhz * (double)((uint32_t)1 << RADIOLIB_SX126X_DIV_EXPONENT) / RADIOLIB_SX126X_CRYSTAL_FREQ);
+    uint8_t standby = RADIOLIB_SX126X_STANDBY_XOSC;
+    uint8_t freq[4] = { (uint8_t)(frf >> 24), (uint8_t)(frf >> 16), (uint8_t)(frf >> 8), (uint8_t)frf };
+    uint8_t timeout[3] = { rxSetRxTimeout[0], rxSetRxTimeout[1], rxSetRxTimeout[2] };
+    int state = mod->SPIwriteStream(RADIOLIB_SX126X_CMD_SET_STANDBY, &standby, 1);
+    if (state == RADIOLIB_ERR_NONE) state = mod->SPIwriteStream(RADIOLIB_SX126X_CMD_SET_RF_FREQUENCY, freq, 4);
+    if (state == RADIOLIB_ERR_NONE) state = mod->SPIwriteStream(RADIOLIB_SX126X_CMD_SET_RX, timeout, 3);
+    return state;
+}
+
+// Radio task: move to the trim loop() asked for, in a gap between packets.
+// A preamble or sync word still latched after a maximum-size packet's airtime was noise
+// (or a stream with no gaps): the flags are cleared and the next clear moment is taken.
+// The request is taken before the offset is read, so an AFC: landing meanwhile raises it again.
+TickType_t afcService() {
+    static bool waiting = false;
+    static int64_t waitSince = 0;
+    if (!afcRetunePending.load(std::memory_order_relaxed)) return portMAX_DELAY;
+    if (radio == nullptr || injectRadioStopped) return portMAX_DELAY;   // Applied once it listens again
+    afcRetunePending.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (scanActive.load(std::memory_order_relaxed)) {
+        // scanFinish() puts the trim back unless the scan found the carrier
+        waiting = false;
+        return portMAX_DELAY;
+    }
+    int32_t target = afcOffsetHz.load(std::memory_order_relaxed);
+    if (target == afcAppliedHz.load(std::memory_order_relaxed)) {
+        waiting = false;
+        return portMAX_DELAY;
+    }
+
+    Module* mod = radio->getMod();
+    int64_t start = esp_timer_get_time();
+    if (rxIrqStatus(mod) & (RADIOLIB_SX126X_IRQ_PREAMBLE_DETECTED | RADIOLIB_SX126X_IRQ_SYNC_WORD_VALID)) {
+        if (!waiting) {
+            waiting = true;
+            waitSince = start;
+            afcGapWaits++;
+        }
+        float airtimeUs = (rfPreambleLen + SYNC_WORD_LEN * 8 + MAX_PACKET_SIZE * 8) * 1000.0f / rfBitrate;
+        if ((float)(start - waitSince) > airtimeUs) {
+            uint8_t clear[2] = { 0, RADIOLIB_SX126X_IRQ_PREAMBLE_DETECTED | RADIOLIB_SX126X_IRQ_SYNC_WORD_VALID };
+            mod->SPIwriteStream(RADIOLIB_SX126X_CMD_CLEAR_IRQ_STATUS, clear, 2);
+            waitSince = start;
+        }
+        afcRetunePending.store(true, std::memory_order_relaxed);    // Still ours: try again in the next gap
+        return pdMS_TO_TICKS(AFC_GAP_POLL_MS);
+    }
+    waiting = false;
+
+    if (afcTune(target) == RADIOLIB_ERR_NONE) {
+        afcAppliedHz.store(target, std::memory_order_relaxed);
+        afcRetunes++;
     } else {
-        packetsLarge++;
+        configureRadio();           // Back on rfFrequency with every setting rewritten
+        afcAppliedHz.store(0, std::memory_order_relaxed);
+    }
+    radioBlindUs += (uint32_t)(esp_timer_get_time() - start);
+    return portMAX_DELAY;
+}
+
+// Radio task, after a runtime CFG: a rewritten frequency (or a failed retune) is rfFrequency
+// without the trim, which goes back on in the next gap
+void afcRadioRetuned() {
+    if (radioReconfigResult != RADIOLIB_ERR_NONE || (radioRetuneChanged & RETUNE_FREQUENCY)) {
+        afcAppliedHz.store(0, std::memory_order_relaxed);
+        if (afcOffsetHz.load(std::memory_order_relaxed) != 0) afcRetunePending.store(true, std::memory_order_relaxed);
     }
 }
 
+void initAfc() {
+    if (prefs.begin(NVS_NAMESPACE, true)) {
+        int32_t trim = prefs.getInt(NVS_KEY_AFC_TRIM, 0);
+        prefs.end();
+        if (trim >= -AFC_MAX_TRIM_KHZ * 1000 && trim <= AFC_MAX_TRIM_KHZ * 1000) afcOffsetHz.store(trim);
+    }
+}
+
+// AFC:<kHz> trims the receiver by a signed offset from the configured frequency, AFC:0 removes it
+void handleAfcCommand(const char* arg) {
+    char* end;
+    double khz = strtod(arg, &end);
+    if (end == arg || *end != '\0' || khz < -AFC_MAX_TRIM_KHZ || khz > AFC_MAX_TRIM_KHZ) {
+        hostPrintf("AFC_ERR:Offset must be -%d to %d kHz\n", AFC_MAX_TRIM_KHZ, AFC_MAX_TRIM_KHZ);
+        return;
+    }
+    int32_t offsetHz = (int32_t)lround(khz * 1000.0);
+    afcSetTrim(offsetHz, true);
+    hostPrintf("AFC_OK:offset=%+.3fkHz\n", offsetHz / 1000.0f);
+}
+
+void sendAfcStatus() {
+    hostPrintf("AFC_OK:offset=%+.3fkHz tuned=%+.3fkHz retunes=%lu waits=%lu\n",
+               afcOffsetHz.load() / 1000.0f, afcAppliedHz.load() / 1000.0f, afcRetunes, afcGapWaits);
+}
+
 // ============================================================================
-// USB Packet Forwarding
+// Acquisition Scan
 // ============================================================================
+//
+// SCAN: looks for the transmitter when its frequency or settings are not
+// known. The grid is every enabled preset (bitrate, deviation, bandwidth) times
+// the offsets 0, +step, -step, +2*step, ... out to the span around the
+// frequency the scan started on, preset by preset. At each point the radio task
+// listens for the dwell time plus one maximum-size packet at that bitrate, so a
+// transmitter sending back to back starts at least one preamble in the window,
+// and polls the SX1262's latched PreambleDetected / SyncWordValid flags and its
+// instantaneous RSSI. A CRC-valid packet locks the point at once. Otherwise the
+// best point of a whole pass wins: sync word (or an RX-done) over repeated
+// preamble detections over RSSI energy well above that preset's quietest
+// offset. The lock is left running with the normal IRQ setup and loop()
+// reports and saves it like an accepted CFG:. Without a hit after
+// SCAN_MAX_PASSES passes the radio goes back to where it started.
+
+struct ScanPreset {
+    float bitrate;
+    float deviation;
+    float rxBandwidth;
+};
+
+// Bits 1-5 of the SCAN: preset mask; bit 0 is the config the scan starts from
+static const ScanPreset SCAN_PRESETS[] = {
+    { 96.0f, 50.0f, 467.0f },       // The defaults
+    { 50.0f, 25.0f, 156.2f },
+    { 38.4f, 20.0f, 117.3f },
+    { 19.2f, 10.0f, 58.6f },
+    { 9.6f, 5.0f, 29.3f },
+};
+#define SCAN_PRESET_COUNT       (1 + sizeof(SCAN_PRESETS) / sizeof(SCAN_PRESETS[0]))
+
+enum ScanHit : uint8_t {
+    SCAN_HIT_NONE,
+    SCAN_HIT_RSSI,
+    SCAN_HIT_PREAMBLE,
+    SCAN_HIT_SYNC,
+    SCAN_HIT_PACKET,
+};
+static const char* const SCAN_HIT_NAMES[] = { "none", "rssi", "preamble", "sync", "packet" };
+
+// Written by the radio task before scanResultReady, read by loop()
+struct ScanResult {
+    RfConfig cfg;           // The locked point, or where the radio went back to
+    uint8_t hit;            // ScanHit
+    bool stopped;           // SCAN:STOP or a CFG: ended it
+    float rssi;             // Peak at the locked point
+    uint16_t points;        // Points listened to
+    uint8_t passes;
+    uint32_t elapsedMs;
+};
+ScanResult scanResult = {};
+
+// Radio task state
+static ScanPreset scanPresetList[SCAN_PRESET_COUNT];
+static uint8_t scanPresetCount = 0;
+static uint16_t scanOffsetCount = 0;        // Offsets per preset
+static uint16_t scanActiveStepKhz = 0;
+static uint16_t scanActiveDwellMs = 0;
+static uint16_t scanPointCount = 0;
+static uint16_t scanPoint = 0;
+static uint8_t scanPass = 0;
+static uint16_t scanVisited = 0;
+static RfConfig scanOrigin;
+static int64_t scanStartMicros = 0;
+static int64_t scanPointEnd = 0;
+
+// Current point
+static uint32_t scanPacketsSeen = 0;        // scanPackets when the point was tuned
+static uint32_t scanRxDoneSeen = 0;         // packetsTotal when the point was tuned
+static uint16_t scanPreambles = 0;
+static uint16_t scanSyncs = 0;
+static float scanPeakRssi = 0.0f;
+
+// Best of the pass so far
+static uint16_t scanBestPoint = 0;
+static uint8_t scanBestHit = SCAN_HIT_NONE;
+static uint16_t scanBestCount = 0;
+static float scanBestRssi = 0.0f;
+static float scanFloorRssi = 0.0f;          // Quietest offset of the current preset
+static float scanPresetPeak = 0.0f;
+static uint16_t scanPresetPeakPoint = 0;
+static float scanEnergyMargin = 0.0f;       // Best peak above its preset's floor, 0 if none
+static uint16_t scanEnergyPoint = 0;
+static float scanEnergyRssi = 0.0f;
+
+static RfConfig scanPointConfig(uint16_t point) {
+    uint16_t k = point % scanOffsetCount;
+    int32_t offsetHz = (int32_t)((k + 1) / 2) * scanActiveStepKhz * 1000;
+    if ((k & 1) == 0) offsetHz = -offsetHz;
+    const ScanPreset& preset = scanPresetList[point / scanOffsetCount];
+    RfConfig cfg = { (float)(scanOrigin.frequency + offsetHz / 1e6), preset.bitrate, preset.deviation,
+                     preset.rxBandwidth, scanOrigin.preambleLen };
+    return cfg;
+}
 
-void forwardPacket(uint8_t* data, int len, float rssi, float snr) {
-    uint8_t lenHi = (len >> 8) & 0xFF;
-    uint8_t lenLo = len & 0xFF;
-    int8_t rssiInt = (int8_t)rssi;
-    uint8_t rssiFrac = (uint8_t)(abs(rssi - rssiInt) * 100);
-    int8_t snrInt = (int8_t)snr;
-    uint8_t snrFrac = (uint8_t)(abs(snr - snrInt) * 100);
-    
-    uint8_t checksum = lenHi ^ lenLo ^ (uint8_t)rssiInt ^ rssiFrac ^ (uint8_t)snrInt ^ snrFrac;
-    for (int i = 0; i < len; i++) {
-        checksum ^= data[i];
+// Retune in standby as applyPendingRadioConfig() does; RX_IRQ_FLAGS latches the
+// preamble and sync word flags in the IRQ status, without routing them to DIO1
+static int scanTune(const RfConfig& next) {
+    int state = radio->standby();
+    if (state == RADIOLIB_ERR_NONE && next.frequency != rfFrequency) {
+        bool calibrate = imageCalibrationBand(next.frequency) != imageCalibrationBand(rfFrequency);
+        state = radio->setFrequency(next.frequency, calibrate);
     }
-    
-    auto writeStuffed = [](uint8_t b) {
-        if (b == 0x7E) {
-            Serial.write(0x7D);
-            Serial.write(0x5E);
-        } else if (b == 0x7D) {
-            Serial.write(0x7D);
-            Serial.write(0x5D);
-        } else {
-            Serial.write(b);
+    if (state == RADIOLIB_ERR_NONE && next.bitrate != rfBitrate) state = radio->setBitRate(next.bitrate);
+    if (state == RADIOLIB_ERR_NONE && next.deviation != rfDeviation) state = radio->setFrequencyDeviation(next.deviation);
+    if (state == RADIOLIB_ERR_NONE && next.rxBandwidth != rfRxBandwidth) state = radio->setRxBandwidth(next.rxBandwidth);
+    if (state != RADIOLIB_ERR_NONE) return state;
+
+    rfFrequency = next.frequency;
+    rfBitrate = next.bitrate;
+    rfDeviation = next.deviation;
+    rfRxBandwidth = next.rxBandwidth;
+    return rxStartReceive();
+}
+
+static void scanResetPass() {
+    scanBestHit = SCAN_HIT_NONE;
+    scanBestCount = 0;
+    scanEnergyMargin = 0.0f;
+}
+
+static bool scanStartPoint(uint16_t point) {
+    RfConfig cfg = scanPointConfig(point);
+    int64_t start = esp_timer_get_time();
+    int state = scanTune(cfg);
+    int64_t now = esp_timer_get_time();
+    radioBlindUs += (uint32_t)(now - start);
+
+    scanPoint = point;
+    scanPointSince.store(now, std::memory_order_relaxed);
+    scanPacketsSeen = scanPackets.load(std::memory_order_relaxed);
+    scanRxDoneSeen = packetsTotal;
+    scanPreambles = 0;
+    scanSyncs = 0;
+    scanPeakRssi = -160.0f;
+    scanPointEnd = now + scanActiveDwellMs * 1000 + (int64_t)(MAX_PACKET_SIZE * 8 * 1000.0f / cfg.bitrate);
+    scanVisited++;
+    return state == RADIOLIB_ERR_NONE;
+}
+
+// Fold the latched flags into the point and clear them, leaving RX-done to handlePacket()
+static void scanSample() {
+    Module* mod = radio->getMod();
+    uint16_t seen = rxIrqStatus(mod) & (RADIOLIB_SX126X_IRQ_PREAMBLE_DETECTED | RADIOLIB_SX126X_IRQ_SYNC_WORD_VALID);
+    if (seen & RADIOLIB_SX126X_IRQ_PREAMBLE_DETECTED) scanPreambles++;
+    if (seen & RADIOLIB_SX126X_IRQ_SYNC_WORD_VALID) scanSyncs++;
+    if (seen) {
+        uint8_t clear[2] = { (uint8_t)(seen >> 8), (uint8_t)(seen & 0xFF) };
+        mod->SPIwriteStream(RADIOLIB_SX126X_CMD_CLEAR_IRQ_STATUS, clear, 2);
+    }
+    uint8_t raw;
+    if (mod->SPIreadStream(RADIOLIB_SX126X_CMD_GET_RSSI_INST, &raw, 1) == RADIOLIB_ERR_NONE) {
+        float rssi = -(float)raw / 2.0f;
+        if (rssi > scanPeakRssi) scanPeakRssi = rssi;
+    }
+}
+
+// Rank the point that just ended against the rest of the pass
+static void scanFinishPoint() {
+    // handlePacket() clears the flags, so every RX-done is a sync word the poll may have missed
+    uint16_t syncs = scanSyncs + (uint16_t)(packetsTotal - scanRxDoneSeen);
+    uint8_t hit = SCAN_HIT_NONE;
+    uint16_t count = 0;
+    if (syncs > 0) {
+        hit = SCAN_HIT_SYNC;
+        count = syncs;
+    } else if (scanPreambles >= SCAN_MIN_PREAMBLES) {
+        hit = SCAN_HIT_PREAMBLE;
+        count = scanPreambles;
+    }
+    if (hit != SCAN_HIT_NONE &&
+        (hit > scanBestHit || (hit == scanBestHit && (count > scanBestCount ||
+                                                      (count == scanBestCount && scanPeakRssi > scanBestRssi))))) {
+        scanBestPoint = scanPoint;
+        scanBestHit = hit;
+        scanBestCount = count;
+        scanBestRssi = scanPeakRssi;
+    }
+
+    // Energy is judged against the same preset's floor: a wider bandwidth also hears more noise
+    if (scanPoint % scanOffsetCount == 0) {
+        scanFloorRssi = scanPresetPeak = scanPeakRssi;
+        scanPresetPeakPoint = scanPoint;
+    } else {
+        if (scanPeakRssi < scanFloorRssi) scanFloorRssi = scanPeakRssi;
+        if (scanPeakRssi > scanPresetPeak) {
+            scanPresetPeak = scanPeakRssi;
+            scanPresetPeakPoint = scanPoint;
         }
-    };
-    
-    Serial.flush();
-    delayMicroseconds(100);
-    
-    Serial.write(FRAME_DELIMITER);
-    
-    writeStuffed(lenHi);
-    writeStuffed(lenLo);
-    writeStuffed((uint8_t)rssiInt);
-    writeStuffed(rssiFrac);
-    writeStuffed((uint8_t)snrInt);
-    writeStuffed(snrFrac);
-    
-    for (int i = 0; i < len; i++) {
-        writeStuffed(data[i]);
     }
-    
-    writeStuffed(checksum);
-    Serial.write(FRAME_DELIMITER);
-    Serial.flush();
+    float margin = scanPresetPeak - scanFloorRssi;
+    if (scanPoint % scanOffsetCount == scanOffsetCount - 1 &&
+        margin >= SCAN_RSSI_MARGIN_DB && margin > scanEnergyMargin) {
+        scanEnergyMargin = margin;
+        scanEnergyPoint = scanPresetPeakPoint;
+        scanEnergyRssi = scanPresetPeak;
+    }
+}
+
+// Leave scan mode listening normally on cfg and hand the outcome to loop()
+static void scanFinish(const RfConfig& cfg, uint8_t hit, float rssi, bool stopped) {
+    int64_t start = esp_timer_get_time();
+    if (scanTune(cfg) != RADIOLIB_ERR_NONE) {
+        rfFrequency = scanOrigin.frequency;
+        rfBitrate = scanOrigin.bitrate;
+        rfDeviation = scanOrigin.deviation;
+        rfRxBandwidth = scanOrigin.rxBandwidth;
+        configureRadio();
+        hit = SCAN_HIT_NONE;
+    }
+    int64_t now = esp_timer_get_time();
+    radioBlindUs += (uint32_t)(now - start);
+
+    // Back on rfFrequency: a lock replaces the trim (scanReport() clears it), otherwise it goes back on
+    afcAppliedHz.store(0, std::memory_order_relaxed);
+    if (hit == SCAN_HIT_NONE && afcOffsetHz.load(std::memory_order_relaxed) != 0) {
+        afcRetunePending.store(true, std::memory_order_relaxed);
+    }
+
+    scanResult.cfg.frequency = rfFrequency;
+    scanResult.cfg.bitrate = rfBitrate;
+    scanResult.cfg.deviation = rfDeviation;
+    scanResult.cfg.rxBandwidth = rfRxBandwidth;
+    scanResult.cfg.preambleLen = rfPreambleLen;
+    scanResult.hit = hit;
+    scanResult.stopped = stopped;
+    scanResult.rssi = rssi;
+    scanResult.points = scanVisited;
+    scanResult.passes = scanPass + 1;
+    scanResult.elapsedMs = (uint32_t)((now - scanStartMicros) / 1000);
+    scanActive.store(false, std::memory_order_relaxed);
+    scanResultReady.store(true, std::memory_order_release);
+}
+
+static void scanBegin() {
+    scanOrigin.frequency = rfFrequency;
+    scanOrigin.bitrate = rfBitrate;
+    scanOrigin.deviation = rfDeviation;
+    scanOrigin.rxBandwidth = rfRxBandwidth;
+    scanOrigin.preambleLen = rfPreambleLen;
+    scanActiveStepKhz = scanStepKhz.load(std::memory_order_relaxed);
+    scanActiveDwellMs = scanDwellMs.load(std::memory_order_relaxed);
+    scanOffsetCount = 1 + 2 * (scanSpanKhz.load(std::memory_order_relaxed) / scanActiveStepKhz);
+
+    uint8_t mask = scanPresetMask.load(std::memory_order_relaxed);
+    scanPresetCount = 0;
+    if (mask & 0x01) {
+        ScanPreset current = { rfBitrate, rfDeviation, rfRxBandwidth };
+        scanPresetList[scanPresetCount++] = current;
+    }
+    for (uint8_t i = 0; i < SCAN_PRESET_COUNT - 1; i++) {
+        const ScanPreset& p = SCAN_PRESETS[i];
+        bool isCurrent = p.bitrate == rfBitrate && p.deviation == rfDeviation && p.rxBandwidth == rfRxBandwidth;
+        if ((mask & (0x02 << i)) && !((mask & 0x01) && isCurrent)) scanPresetList[scanPresetCount++] = p;
+    }
+    scanPointCount = scanPresetCount * scanOffsetCount;
+
+    scanPass = 0;
+    scanVisited = 0;
+    scanStartMicros = esp_timer_get_time();
+    scanResetPass();
+    scanActive.store(true, std::memory_order_relaxed);
+    logPrintf("[SCAN] %u presets x %u offsets from %.3f MHz\n", scanPresetCount, scanOffsetCount, rfFrequency);
+    if (!scanStartPoint(0)) scanFinish(scanOrigin, SCAN_HIT_NONE, 0.0f, false);
+}
+
+// Forward task: a CRC-valid radio packet, counted for the point it was heard on
+void scanRecord(const RxSlot* slot) {
+    if (scanActive.load(std::memory_order_relaxed) && slot->rxMicros >= scanPointSince.load(std::memory_order_relaxed)) {
+        scanPackets.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Radio task: advance the scan; returns the next wait
+TickType_t scanService() {
+    // The grid was stored before the request, so it is complete once the request is seen
+    if (radio != nullptr && scanStartPending.exchange(false, std::memory_order_acquire)) {
+        if (!scanActive.load(std::memory_order_relaxed)) scanBegin();
+    }
+    if (scanStopPending.exchange(false, std::memory_order_relaxed)) {
+        if (scanActive.load(std::memory_order_relaxed)) scanFinish(scanOrigin, SCAN_HIT_NONE, 0.0f, true);
+    }
+    if (!scanActive.load(std::memory_order_relaxed)) return portMAX_DELAY;
+
+    if (scanPackets.load(std::memory_order_relaxed) != scanPacketsSeen) {
+        scanFinish(scanPointConfig(scanPoint), SCAN_HIT_PACKET, scanPeakRssi, false);
+        return portMAX_DELAY;
+    }
+    scanSample();
+    // Packets still being validated may belong to this point
+    if (esp_timer_get_time() < scanPointEnd || rxRingHead.load() != rxRingTail.load()) {
+        return pdMS_TO_TICKS(SCAN_SAMPLE_MS);
+    }
+    scanFinishPoint();
+
+    uint16_t next = scanPoint + 1;
+    if (next == scanPointCount) {
+        // End of a pass: lock on its best point, or go round again
+        if (scanBestHit != SCAN_HIT_NONE) {
+            scanFinish(scanPointConfig(scanBestPoint), scanBestHit, scanBestRssi, false);
+            return portMAX_DELAY;
+        }
+        if (scanEnergyMargin > 0.0f) {
+            scanFinish(scanPointConfig(scanEnergyPoint), SCAN_HIT_RSSI, scanEnergyRssi, false);
+            return portMAX_DELAY;
+        }
+        if (scanPass + 1 >= SCAN_MAX_PASSES) {
+            scanFinish(scanOrigin, SCAN_HIT_NONE, 0.0f, false);
+            return portMAX_DELAY;
+        }
+        scanPass++;
+        scanResetPass();
+        next = 0;
+    }
+    if (!scanStartPoint(next)) {
+        scanFinish(scanOrigin, SCAN_HIT_NONE, 0.0f, false);
+        return portMAX_DELAY;
+    }
+    return pdMS_TO_TICKS(SCAN_SAMPLE_MS);
+}
+
+// Radio task, before a runtime CFG: stop where we are and let the CFG retune
+void scanAbort() {
+    scanStartPending.store(false, std::memory_order_relaxed);
+    if (!scanActive.load(std::memory_order_relaxed)) return;
+    scanFinish(scanPointConfig(scanPoint), SCAN_HIT_NONE, 0.0f, true);
 }
+
+// loop(): report a finished scan; a lock is saved like an accepted CFG:
+void scanReport() {
+    if (!scanResultReady.load(std::memory_order_acquire)) return;
+    ScanResult r = scanResult;
+    scanResultReady.store(false, std::memory_order_relaxed);
+
+    const RfConfig& c = r.cfg;
+    if (r.hit != SCAN_HIT_NONE) {
+        configSource = "SCAN";
+        displayNeedsFullRedraw = true;
+        // Only a decoded packet or sync word proves the transmitter; preamble or RSSI
+        // alone can be an interferer, and must not replace the saved config
+        bool save = r.hit == SCAN_HIT_PACKET || r.hit == SCAN_HIT_SYNC;
+        if (save) saveRfConfig();
+        afcSetTrim(0, save);
+        hostPrintf("SCAN_OK:%.3f,%.1f,%.1f,%.1f,%d hit=%s rssi=%.1f points=%u passes=%u ms=%lu saved=%d\n",
+                   c.frequency, c.bitrate, c.deviation, c.rxBandwidth, c.preambleLen,
+                   SCAN_HIT_NAMES[r.hit], r.rssi, r.points, r.passes, r.elapsedMs, save ? 1 : 0);
+    } else {
+        hostPrintf("SCAN_ERR:%s after %u points, %lu ms; on %.3f,%.1f,%.1f,%.1f,%d\n",
+                   r.stopped ? "Stopped" : "No signal", r.points, r.elapsedMs,
+                   c.frequency, c.bitrate, c.deviation, c.rxBandwidth, c.preambleLen);
+    }
+}
+
+// SCAN:START, SCAN:<span kHz>,<step kHz>[,<dwell ms>[,<preset mask>]], SCAN:STOP
+void handleScanCommand(const char* args) {
+    if (strcmp(args, "STOP") == 0) {
+        if (!scanActive.load(std::memory_order_relaxed) && !scanStartPending.load(std::memory_order_relaxed)) {
+            hostPrintf("SCAN_ERR:Not scanning\n");
+            return;
+        }
+        scanStopPending.store(true, std::memory_order_relaxed);
+        if (radioTaskHandle) xTaskNotifyGive(radioTaskHandle);
+        hostPrintf("SCAN_OK:stopping\n");
+        return;
+    }
+
+    unsigned long span = SCAN_DEFAULT_SPAN_KHZ;
+    unsigned long step = SCAN_DEFAULT_STEP_KHZ;
+    unsigned long dwell = SCAN_DEFAULT_DWELL_MS;
+    unsigned long mask = SCAN_DEFAULT_PRESETS;
+    if (strcmp(args, "START") != 0) {
+        char* end;
+        span = strtoul(args, &end, 10);
+        bool ok = end != args && *end == ',';
+        if (ok) step = strtoul(end + 1, &end, 10);
+        if (ok && *end == ',') dwell = strtoul(end + 1, &end, 10);
+        if (ok && *end == ',') mask = strtoul(end + 1, &end, 16);
+        if (!ok || *end != '\0') {
+            hostPrintf("SCAN_ERR:Expected START or <span>,<step>[,<dwell>[,<presets>]]\n");
+            return;
+        }
+    }
+    if (span > SCAN_MAX_SPAN_KHZ || step < SCAN_MIN_STEP_KHZ || step > SCAN_MAX_SPAN_KHZ) {
+        hostPrintf("SCAN_ERR:Span must be 0-%d kHz, step %d-%d kHz\n",
+                   SCAN_MAX_SPAN_KHZ, SCAN_MIN_STEP_KHZ, SCAN_MAX_SPAN_KHZ);
+        return;
+    }
+    if (dwell < SCAN_SAMPLE_MS || dwell > SCAN_MAX_DWELL_MS) {
+        hostPrintf("SCAN_ERR:Dwell must be %d-%d ms\n", SCAN_SAMPLE_MS, SCAN_MAX_DWELL_MS);
+        return;
+    }
+    if (mask == 0 || mask >= (1UL << SCAN_PRESET_COUNT)) {
+        hostPrintf("SCAN_ERR:Presets must be 1-%lX\n", (1UL << SCAN_PRESET_COUNT) - 1);
+        return;
+    }
+    uint32_t presets = __builtin_popcount(mask);
+    for (uint8_t i = 0; i < SCAN_PRESET_COUNT - 1; i++) {
+        const ScanPreset& p = SCAN_PRESETS[i];
+        if ((mask & 0x01) && (mask & (0x02 << i)) && p.bitrate == rfBitrate &&
+            p.deviation == rfDeviation && p.rxBandwidth == rfRxBandwidth) {
+            presets--;      // Scanned once, as the current config
+        }
+    }
+    uint32_t points = (1 + 2 * (span / step)) * presets;
+    if (points > SCAN_MAX_POINTS) {
+        hostPrintf("SCAN_ERR:%lu points, at most %d\n", points, SCAN_MAX_POINTS);
+        return;
+    }
+    RfConfig lowest = { rfFrequency - span / 1000.0f, rfBitrate, rfDeviation, rfRxBandwidth, rfPreambleLen };
+    RfConfig highest = lowest;
+    highest.frequency = rfFrequency + span / 1000.0f;
+    if (rfConfigInvalidField(lowest) != nullptr || rfConfigInvalidField(highest) != nullptr) {
+        hostPrintf("SCAN_ERR:Span leaves the frequency range\n");
+        return;
+    }
+    if (scanActive.load(std::memory_order_relaxed) || scanStartPending.load(std::memory_order_relaxed)) {
+        hostPrintf("SCAN_ERR:Already scanning\n");
+        return;
+    }
+    if (injectRate > 0 && injectRadioOff) {
+        hostPrintf("SCAN_ERR:Injector has the radio off\n");
+        return;
+    }
+
+    scanSpanKhz.store(span, std::memory_order_relaxed);
+    scanStepKhz.store(step, std::memory_order_relaxed);
+    scanDwellMs.store(dwell, std::memory_order_relaxed);
+    scanPresetMask.store(mask, std::memory_order_relaxed);
+    scanStartPending.store(true, std::memory_order_release);
+    if (radioTaskHandle) xTaskNotifyGive(radioTaskHandle);     // Otherwise startRadio() does once RX is armed
+    hostPrintf("SCAN_OK:span=%lukHz step=%lukHz dwell=%lums presets=%02lX points=%lu\n",
+               span, step, dwell, mask, points);
+}
+
+void sendScanStatus() {
+    if (scanActive.load(std::memory_order_relaxed)) {
+        hostPrintf("SCAN_OK:state=scanning point=%u/%u pass=%u best=%s\n",
+                   scanPoint + 1, scanPointCount, scanPass + 1, SCAN_HIT_NAMES[scanBestHit]);
+    } else {
+        hostPrintf("SCAN_OK:state=idle last=%s points=%u ms=%lu\n",
+                   SCAN_HIT_NAMES[scanResult.hit], scanResult.points, scanResult.elapsedMs);
+    }
+}
+
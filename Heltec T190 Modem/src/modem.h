@@ -0,0 +1,554 @@
+/*
+ * Shared by the firmware modules: build switches, configuration, the state
+ * that crosses module boundaries, and the module interfaces. main.cpp owns the
+ * radio, the RX pipeline and the host commands; each transport (USB output,
+ * replay, BLE, Wi-Fi) and the sink layer feeding them has its own file.
+ */
+
+#pragma once
+
+#ifndef ENABLE_BENCHMARKS
+#define ENABLE_BENCHMARKS       1         // -DENABLE_BENCHMARKS=0 drops the BENCH command
+#endif
+#ifndef ENABLE_WIFI
+#define ENABLE_WIFI             1         // -DENABLE_WIFI=0 drops the Wi-Fi UDP sink
+#endif
+#ifndef ENABLE_BLE
+#define ENABLE_BLE              1         // -DENABLE_BLE=0 drops the BLE transport and its sink
+#endif
+#ifndef ENABLE_USB
+#define ENABLE_USB              1         // -DENABLE_USB=0 drops the USB packet sink; commands and logs stay on CDC
+#endif
+#ifndef USB_VENDOR_LINK
+#define USB_VENDOR_LINK         0         // 1 (OTG build only) sends frames on a vendor bulk interface
+#endif
+#if USB_VENDOR_LINK && ARDUINO_USB_MODE
+#error "USB_VENDOR_LINK needs the TinyUSB stack: build with -DARDUINO_USB_MODE=0"
+#endif
+#if !ENABLE_USB && !ENABLE_BLE && !ENABLE_WIFI
+#error "No output sink left: enable at least one of ENABLE_USB, ENABLE_BLE, ENABLE_WIFI"
+#endif
+#if USB_VENDOR_LINK && !ENABLE_USB
+#error "USB_VENDOR_LINK carries the USB packet sink: build with ENABLE_USB=1"
+#endif
+#include <Arduino.h>
+#include <atomic>
+#include <Preferences.h>
+#include "raptor_crc.h"
+#include "raptor_frame.h"
+#include "raptor_parse.h"
+#include "raptor_lq.h"
+#include "raptor_pipeline.h"
+#include "raptor_sched.h"
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define DEBUG_OUTPUT        false
+
+// Pin Definitions - Heltec Vision Master T190 LoRa
+#define LORA_NSS    8
+#define LORA_SCK    9
+#define LORA_MOSI   10
+#define LORA_MISO   11
+#define LORA_RST    12
+#define LORA_BUSY   13
+#define LORA_DIO1   14
+#define LORA_SPI_FREQ   16000000    // SX1262 maximum SCK
+#define USER_BUTTON 21
+
+// Pin Definitions - Battery Monitoring
+#define ADC_CTRL_PIN    46      // Controls P-FET switch for battery divider
+#define VBAT_READ_PIN   6       // ADC input from voltage divider
+
+// Battery voltage divider: R9=390K, R11=100K -> ratio = 100/(390+100) = 0.204
+#define VBAT_DIVIDER_RATIO  4.9f    // Multiply ADC voltage by this to get VBAT
+#define VBAT_MIN            3.0f    // Empty LiPo
+#define VBAT_MAX            4.2f    // Full LiPo
+#define VBAT_SAMPLE_MS      250     // Battery task period, one divider-on read each
+#define VBAT_AVG_SAMPLES    16      // Moving average length (4 s)
+
+// Pin Definitions - TFT Display (ST7789V3)
+#define TFT_CS      39
+#define TFT_RST     40
+#define TFT_DC      47
+#define TFT_SCLK    38
+#define TFT_MOSI    48
+#define TFT_LED_EN  17
+#define TFT_PWR     7
+
+// Display dimensions (landscape orientation)
+#define TFT_WIDTH   320
+#define TFT_HEIGHT  170
+
+// Default RF Configuration
+#define DEFAULT_FREQUENCY       915.0
+#define DEFAULT_BITRATE         96.0
+#define DEFAULT_DEVIATION       50.0
+#define DEFAULT_RX_BANDWIDTH    467.0
+#define DEFAULT_PREAMBLE_LEN    32
+#define RF_DATA_SHAPING         0.5
+
+// Configuration timeout
+#define CONFIG_TIMEOUT_MS       120000    // 2 minutes
+
+// Last accepted CFG: in NVS; the key carries the RfConfig layout version
+#define NVS_NAMESPACE           "raptormodem"
+#define NVS_KEY_RF_CONFIG       "rf1"
+
+// Runtime CFG: handoff to the radio task
+#define RADIO_RECONFIG_TIMEOUT_MS 1000    // loop() waits this long for the radio task to apply CFG
+
+// Settings touched by a runtime retune
+#define RETUNE_FREQUENCY        0x01
+#define RETUNE_BITRATE          0x02
+#define RETUNE_DEVIATION        0x04
+#define RETUNE_BANDWIDTH        0x08
+#define RETUNE_PREAMBLE         0x10
+
+// Periodic stats report (STATS: command)
+#define STATS_DEFAULT_INTERVAL_MS   10000
+#define STATS_MIN_INTERVAL_MS       100
+#define STATS_MAX_INTERVAL_MS       60000
+#define STATS_FORMAT_TEXT           0x01  // [STATS] / [LAT] lines
+#define STATS_FORMAT_BINARY         0x02  // FRAME_STATS_TAG frame
+#define STATS_FRAME_VERSION         8         // Bumped on every payload layout change, see README
+#define STATS_PAYLOAD_MAX           320
+#define STATS_COUNTER_COUNT         25        // N in the stats frame
+#define LAT_PAYLOAD_MAX             464       // LAT:BIN full histogram frame
+
+// Link-quality analytics (LQ: command)
+#define LQ_GAP_DEFAULT_MS           2000      // Silence this long between valid packets is a gap
+#define LQ_GAP_MIN_MS               200
+#define LQ_GAP_MAX_MS               60000
+#define LQ_MINUTES_REPORTED         10        // Per-minute PER values in the LQ? reply
+
+// Display update configuration
+#define DISPLAY_UPDATE_INTERVAL_MS  500
+#define DISPLAY_STATS_INTERVAL_MS   1000
+
+// loop() housekeeping jobs (SCHED? command); budgets are expected worst cases per run
+#define SCHED_PASS_BUDGET_US        5000      // A pass starts no further job that would end past this
+#define SCHED_COMMAND_BUDGET_US     2000
+#define SCHED_STATS_BUDGET_US       4000
+#define SCHED_SCAN_BUDGET_US        5000      // Includes the NVS write of a scan result
+#define SCHED_POWER_BUDGET_US       200
+
+// Power-managed receive (PWR: command, saved in NVS)
+#define POWER_MAX_MHZ               240
+#define POWER_MIN_MHZ               80        // Lowest step that keeps APB, and so SPI timing, at 80 MHz
+#define POWER_LOOP_IDLE_MS          20        // loop() blocks this long per pass so the CPU can idle
+#define POWER_DIO1_POLL_MS          50        // Radio task looks for an RX-done edge lost to light sleep
+#define POWER_USB_CHECK_MS          500       // loop() re-checks for a USB host, which keeps light sleep off
+#define POWER_BACKLIGHT_IDLE_MS     30000     // Backlight off after this long without packets, commands or button
+#define POWER_DISPLAY_IDLE_MS       1000      // Display task period while the backlight is off
+#define NVS_KEY_POWER_SAVE          "pwr"
+
+// Sync word "RAPT"
+const uint8_t SYNC_WORD[] = {0x52, 0x41, 0x50, 0x54};
+#define SYNC_WORD_LEN       4
+
+// RaptorHAB packet layout (PKT_*) and output classes: raptor_pipeline.h
+
+// Per-image RaptorQ symbol accounting
+#define IMAGE_TRACK_SLOTS       8
+#define IMAGE_MAX_SYMBOLS       16384     // Bitmap bits per image (2 KB each, PSRAM)
+#define IMAGE_DECODE_OVERHEAD   2         // RaptorQ: K+2 symbols decode with ~1e-6 failure
+
+// On-modem image reassembly (IMG:OUT: command): the systematic RaptorQ symbols put in place, no
+// repair decoding; IMAGE-mode links get the raw symbols until complete and then the whole image
+#define IMAGE_RECON_SLOTS       2         // Images reassembled at once
+#define IMAGE_RECON_MAX_BYTES   (256 * 1024)  // Per image, PSRAM only
+#define IMAGE_PAYLOAD_ID_SIZE   4         // RaptorQ packet header in each 0x02 symbol: SBN:1 ESI:3
+#define IMAGE_CHUNK_HEADER      14        // image_id:2 size:4 crc32:4 offset:4
+#define IMAGE_CHUNK_BYTES       1024      // Image bytes per USB chunk frame
+#define IMAGE_BLE_BURST         4         // Chunk notifications per forward task pass
+#define IMAGE_FAIL_IDLE_MS      5000      // An incomplete image with no symbols for this long has failed
+#define IMAGE_OUTPUT_USB        0
+#define IMAGE_OUTPUT_BLE        1
+#define IMAGE_OUTPUTS           2
+#define IMAGE_MODE_RAW          0         // Sink gets the raw 0x02 symbols (default)
+#define IMAGE_MODE_IMAGE        1         // Sink gets the 0x02 symbols until the image is complete, then the image
+#define IMAGE_MODE_BOTH         2
+
+// Duplicate suppression (open-addressed set of recently forwarded packet keys)
+#define DEDUP_TABLE_SIZE        1024      // Must be a power of two
+#define DEDUP_MAX_PROBE         8
+#define DEDUP_WINDOW            512       // Keys remembered, counted in insertions
+
+// Serial Protocol (frame layout and sizes in raptor_frame.h)
+#define SERIAL_BAUD         921600
+#define SERIAL_TX_BUFFER_SIZE   4096      // HWCDC only; TinyUSB's CDC FIFO is fixed by the core
+#define HOST_LINE_MAX           256       // Longest text reply or log line, '\n' included
+#define CDC_FRAME_WRITE_MS      5         // TinyUSB CDC: longest wait for the FIFO to take the rest of a frame
+#define VENDOR_CLOSE_MS         1000      // Vendor link: no bytes taken for this long means the host closed it
+
+// CRC32 engine (selected at compile time, e.g. -DCRC32_ENGINE=CRC32_ENGINE_SLICE8)
+#define CRC32_ENGINE_BITWISE    0         // Reference implementation, 8 iterations/byte
+#define CRC32_ENGINE_SLICE8     1         // Slicing-by-8, 8KB table in DRAM
+#define CRC32_ENGINE_ROM        2         // ESP32-S3 ROM crc32_le
+#ifndef CRC32_ENGINE
+#define CRC32_ENGINE            CRC32_ENGINE_ROM
+#endif
+
+// On-target micro-benchmarks (BENCH command); links the slice8 table whatever the engine
+#define BENCH_TARGET_OPS        2000      // Per stage; keeps a BENCH run well under a second
+
+// RX pipeline (FreeRTOS)
+#ifndef RX_CONTINUOUS
+#define RX_CONTINUOUS           1         // Radio stays in RX across packets; 0 = SetRx after each one
+#endif
+#if RX_CONTINUOUS
+#define RX_TIMEOUT_RAW          RADIOLIB_SX126X_RX_TIMEOUT_INF    // SetRx 0xFFFFFF: continuous RX
+#else
+#define RX_TIMEOUT_RAW          RADIOLIB_SX126X_RX_TIMEOUT_NONE   // SetRx 0x000000: single, standby after RX-done
+#endif
+#define RX_FIFO_SIZE            256       // SX1262 data buffer; continuous RX wraps packets around it
+#define RX_FOLLOW_MAX           2         // Follow-up packets read behind one DIO1 edge
+// RX-done on DIO1; preamble and sync word only latch, for handlePacket() and the scan
+#define RX_IRQ_FLAGS            (RADIOLIB_SX126X_IRQ_RX_DEFAULT | RADIOLIB_SX126X_IRQ_PREAMBLE_DETECTED | \
+                                 RADIOLIB_SX126X_IRQ_SYNC_WORD_VALID)
+#define RX_RING_SLOTS           32        // Must be a power of two
+#define RADIO_TASK_CORE         1
+#define RADIO_TASK_PRIORITY     (configMAX_PRIORITIES - 2)
+#define RADIO_TASK_STACK        4096
+#define FORWARD_TASK_CORE       0
+#define FORWARD_TASK_PRIORITY   (configMAX_PRIORITIES - 4)
+#define FORWARD_TASK_STACK      6144
+#define DISPLAY_TASK_CORE       0         // Never the radio core
+#define DISPLAY_TASK_PRIORITY   1
+#define DISPLAY_TASK_STACK      4096
+#define BATTERY_TASK_CORE       0         // Never the radio core
+#define BATTERY_TASK_PRIORITY   1
+#define BATTERY_TASK_STACK      2048
+
+// Store-and-forward replay buffer (PSRAM), filled while the USB host isn't draining
+#define REPLAY_BUFFER_BYTES     (4 * 1024 * 1024)
+#define REPLAY_BUFFER_FALLBACK  (1024 * 1024)   // Tried when the full size doesn't fit
+#define REPLAY_RECORD_HEADER    20        // LEN:2 RSVD:2 RSSI:4 SNR:4 RX_US:8
+#define REPLAY_WRAP_MARKER      0xFFFF    // LEN value: rest of the buffer is unused
+#define REPLAY_DEFAULT_RATIO    4         // Backlog frames sent per live frame
+#define REPLAY_MAX_RATIO        64
+#define REPLAY_IDLE_POLL_MS     2         // Forward task wake-up while a backlog drains to a reading host
+
+// Output scheduler: strict priority for telemetry/ACK/text over image symbols
+#define OUTPUT_POOL_SLOTS       48        // Frames waiting for USB space
+#define OUTPUT_DEFAULT_WATERMARK 24       // Queued frames at which image data is shed
+#define OUTPUT_HOST_STALL_MS    250       // No USB progress this long: host is away, spill to replay
+#define BLE_CONGESTION_HOLD_MS  500       // Image data skips BLE this long after a failed notify
+
+// Output sinks: every transport queues references into one shared packet pool
+#define SINK_BLE_QUEUE_LEN      16        // Packets waiting to be batched into BLE notifications
+#define SINK_NET_QUEUE_LEN      16        // Per Wi-Fi subscriber; must be a power of two
+#define SINK_NO_REF             0xFF
+
+// Frequency trim (AFC: command, saved in NVS); applied between packets, see the AFC section
+#define AFC_GAP_POLL_MS         1         // Radio task re-checks for a gap between packets this often
+#define AFC_MAX_TRIM_KHZ        100
+#define NVS_KEY_AFC_TRIM        "afctrim" // Signed Hz
+
+// Acquisition scan (SCAN: command) over frequency offsets and radio presets, see the scan section
+#define SCAN_DEFAULT_SPAN_KHZ   50        // Offsets from -span to +span around rfFrequency
+#define SCAN_DEFAULT_STEP_KHZ   25
+#define SCAN_DEFAULT_DWELL_MS   30        // Per point, plus one maximum-size packet at the preset bitrate
+#define SCAN_DEFAULT_PRESETS    0x3F      // Bit 0: the current config; bits 1-5: SCAN_PRESETS
+#define SCAN_MAX_SPAN_KHZ       500
+#define SCAN_MIN_STEP_KHZ       5
+#define SCAN_MAX_DWELL_MS       2000
+#define SCAN_MAX_POINTS         512
+#define SCAN_MAX_PASSES         3         // Grid repeats without a hit before giving up
+#define SCAN_SAMPLE_MS          4         // IRQ flag and RSSI poll period while dwelling
+#define SCAN_MIN_PREAMBLES      2         // Preamble detections that count as a hit without a sync word
+#define SCAN_RSSI_MARGIN_DB     10.0f     // Peak above the preset's quietest offset that counts as energy
+
+// Synthetic packet injector (INJ: command), loads the forward path without a transmitter
+#define INJECT_MAX_RATE         20000     // Packets/s
+#define INJECT_BURST_MAX        64        // Packets generated per radio task wake-up
+#define INJECT_DEFAULT_MIN_LEN  32
+#define INJECT_DEFAULT_MAX_LEN  MAX_PACKET_SIZE
+#define INJECT_IMAGE_MIN_LEN    64        // Longer packets are image data, shorter ones telemetry
+#define INJECT_IMAGE_ID         0xFFFE    // image_id of injected image data
+
+// Bluetooth LE (Nordic UART Service)
+#define BLE_DEVICE_NAME     "RaptorModem"
+#define BLE_PASSKEY         123456
+#define BLE_PREFERRED_MTU   517
+#define BLE_NOTIFY_MAX      (BLE_PREFERRED_MTU - 3)
+#define BLE_DLE_TX_OCTETS   251       // Data length extension: max LL payload
+#define BLE_DLE_TX_TIME     2120      // us, time for 251 octets at 1M PHY
+#define BLE_CONN_INTERVAL_MIN   6     // x1.25 ms
+#define BLE_CONN_INTERVAL_MAX   12    // x1.25 ms
+#define BLE_CONN_TIMEOUT        400   // x10 ms
+#define BLE_CMD_QUEUE_LEN   4
+#define BLE_CMD_MAX_LEN     64
+#define BLE_RECORD_OVERHEAD 9         // LEN + RSSI f32 + SNR f32 per batched packet
+#define BLE_BATCH_HEADER    4         // "PKB" + COUNT
+#define BLE_CHUNK_HEADER    5         // "CHK" + CHUNK# + TOTAL
+#define NUS_SERVICE_UUID    "6E400001-B5A3-F393-E0A9-E50E24DCCA9E"
+#define NUS_RX_UUID         "6E400002-B5A3-F393-E0A9-E50E24DCCA9E"
+#define NUS_TX_UUID         "6E400003-B5A3-F393-E0A9-E50E24DCCA9E"
+
+// Wi-Fi UDP fan-out (station mode; credentials from WIFI: in NVS)
+#define NET_UDP_PORT            4540      // Subscribers send "SUB" here, datagrams come back from it
+#define NET_MAX_SUBSCRIBERS     4
+#define NET_DATAGRAM_MAX        1400      // Fits a 1500-byte MTU after IP/UDP headers
+#define NET_BATCH_FRAMES_MAX    64        // Frames per datagram
+#define NET_BATCH_MS            10        // A partly filled datagram waits at most this long
+#define NET_SUBSCRIBER_TIMEOUT_MS 30000   // Forget a subscriber that hasn't re-sent SUB
+#define NET_IDLE_POLL_MS        100       // Control poll with no subscribers
+#define NET_DOWN_POLL_MS        500       // Link check while not associated
+#define NET_SSID_MAX            33
+#define NET_PASS_MAX            65
+#define NVS_KEY_WIFI_SSID       "wifiSsid"
+#define NVS_KEY_WIFI_PASS       "wifiPass"
+#define NET_TASK_CORE           0         // Never the radio core
+#define NET_TASK_PRIORITY       2
+#define NET_TASK_STACK          4096
+
+// Link sparkline, right of the radio settings: one bar per second for the last LQ_SECONDS
+#define SPARK_X                 198
+#define SPARK_Y                 46
+#define SPARK_HEIGHT            36
+#define SPARK_BAR_WIDTH         2
+
+// Colors for display
+#define COLOR_BG            ST77XX_BLACK
+#define COLOR_HEADER        0x001F   // Dark blue
+#define COLOR_TEXT          ST77XX_WHITE
+#define COLOR_LABEL         0x8410   // Gray
+#define COLOR_VALUE         ST77XX_CYAN
+#define COLOR_GOOD          ST77XX_GREEN
+#define COLOR_WARN          ST77XX_YELLOW
+#define COLOR_BAD           ST77XX_RED
+#define COLOR_ACCENT        0x07FF   // Cyan
+
+// ============================================================================
+// Debug macros
+// ============================================================================
+
+#if DEBUG_OUTPUT
+  #define DBG(x) Serial.print(x)
+  #define DBGLN(x) Serial.println(x)
+  #define DBGF(...) Serial.printf(__VA_ARGS__)
+#else
+  #define DBG(x)
+  #define DBGLN(x)
+  #define DBGF(...)
+#endif
+
+// ============================================================================
+// Latency Histograms (log2 buckets, microseconds)
+// ============================================================================
+
+// Bucket 0 holds 0-1 us, bucket i holds [2^i, 2^(i+1)) us, the last bucket everything above
+#define LATENCY_BUCKETS     16
+
+struct LatencyHistogram {
+    const char* name;
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t windowMaxUs;       // Since the last stats report
+    bool windowReset;           // Set by the report, cleared by the next sample
+};
+
+extern LatencyHistogram latUsbWrite;
+extern LatencyHistogram latEndToEnd;
+
+static inline void latencyRecord(LatencyHistogram* h, int64_t us) {
+    uint32_t v = us < 0 ? 0 : (us > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)us);
+    int bucket = v < 2 ? 0 : 31 - __builtin_clz(v);
+    if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+    h->buckets[bucket]++;
+    h->count++;
+    h->totalUs += v;
+    if (v > h->maxUs) h->maxUs = v;
+    if (h->windowReset) {
+        h->windowReset = false;
+        h->windowMaxUs = 0;
+    }
+    if (v > h->windowMaxUs) h->windowMaxUs = v;
+}
+
+uint32_t latencyPercentile(const LatencyHistogram* h, uint32_t percent);
+
+// ============================================================================
+// Output Sinks (sinks.cpp)
+// ============================================================================
+
+#if ENABLE_USB
+#define SINK_USB_REFS           OUTPUT_POOL_SLOTS
+#else
+#define SINK_USB_REFS           0
+#endif
+#if ENABLE_BLE
+#define SINK_BLE_REFS           SINK_BLE_QUEUE_LEN
+#else
+#define SINK_BLE_REFS           0
+#endif
+#if ENABLE_WIFI
+#define SINK_NET_REFS           (NET_MAX_SUBSCRIBERS * SINK_NET_QUEUE_LEN)
+#define SINK_NET_COUNT          NET_MAX_SUBSCRIBERS
+#else
+#define SINK_NET_REFS           0
+#define SINK_NET_COUNT          0
+#endif
+#define SINK_POOL_SLOTS         (SINK_USB_REFS + SINK_BLE_REFS + SINK_NET_REFS + 1)
+#define SINK_MAX                (ENABLE_USB + ENABLE_BLE + SINK_NET_COUNT)
+
+static_assert(SINK_POOL_SLOTS < SINK_NO_REF, "Pool references must fit a uint8_t");
+
+struct SinkPacket {
+    RxSlot slot;
+    std::atomic<uint8_t> refs;      // References still held, 0 = free
+};
+
+struct Sink;
+typedef void (*SinkOfferFn)(Sink* sink, uint8_t ref, uint8_t outputClass);
+
+// accepted/dropped are written by the forward task, the rest by the task draining the sink
+struct Sink {
+    const char* name;           // nullptr: not in this build
+    SinkOfferFn offer;          // Forward task: retain the reference or count a drop, never block; nullptr for fixed sinks
+    void* ctx;
+    uint32_t accepted;          // Queued for this sink
+    uint32_t dropped;           // Not queued: no room, or shed under congestion
+    uint32_t sent;              // Handed to the transport
+    uint32_t lost;              // Queued, then discarded (link down, send failed, evicted)
+    uint32_t bytes;             // Packet bytes sent
+    LatencyHistogram latency;   // DIO1 edge -> handed to the transport
+    volatile uint8_t imageMode; // IMAGE_MODE_*, set by IMG:OUT:
+};
+
+extern SinkPacket sinkPool[SINK_POOL_SLOTS];
+extern Sink usbSink;
+extern Sink bleSink;
+
+static inline const RxSlot* sinkSlot(uint8_t ref) {
+    return &sinkPool[ref].slot;
+}
+
+static inline void sinkRetain(uint8_t ref) {
+    sinkPool[ref].refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+static inline void sinkRelease(uint8_t ref) {
+    sinkPool[ref].refs.fetch_sub(1, std::memory_order_release);
+}
+
+// Drain side: one packet is now the transport's
+static inline void sinkDelivered(Sink* sink, uint16_t len, int64_t rxMicros) {
+    sink->sent++;
+    sink->bytes += len;
+    latencyRecord(&sink->latency, esp_timer_get_time() - rxMicros);
+}
+
+void sinkReset(Sink* sink);
+void sinkRegister(Sink* sink, const char* name, SinkOfferFn offer, void* ctx);
+void sinkPublish(const RxSlot* slot, uint8_t outputClass, bool imageRebuilt);
+void sendSinkStatus();
+void handleImageOutputCommand(const char* args);
+void sendImageOutputStatus();
+
+// ============================================================================
+// Shared State (main.cpp)
+// ============================================================================
+
+extern Preferences prefs;
+extern TaskHandle_t forwardTaskHandle;
+extern SemaphoreHandle_t serialMutex;
+extern volatile uint8_t hostFrameFormat;
+extern volatile uint8_t outputHighWater;
+extern volatile uint32_t replayHighWater;
+
+// On-modem image reassembly
+extern uint8_t* imageReconPool;
+extern std::atomic<uint8_t> imageOutputs;
+extern uint32_t imagesDecoded;
+extern uint32_t imagesFailed;
+extern uint32_t imagesSent[IMAGE_OUTPUTS];
+
+void hostPrintf(const char* fmt, ...);
+void logPrintf(const char* fmt, ...);
+size_t serialWriteFrame(const uint8_t* frame, size_t len);
+size_t imageChunkPeek(uint8_t output, uint8_t* out, size_t maxData);
+void imageChunkSent(uint8_t output, size_t len);
+void imageChunkRestart(uint8_t output);
+
+// ============================================================================
+// USB Output (usb_output.cpp)
+// ============================================================================
+
+extern uint32_t packetsShed;
+extern volatile uint8_t outputWatermark;
+extern volatile bool usbHostAway;
+
+bool usbWriteFrame(const RxSlot* slot);
+void usbFlush();
+void sendLinkStatus();
+void initUsbHostEvents();
+#if USB_VENDOR_LINK
+void initVendorLink();
+#endif
+#if ENABLE_USB
+void usbOffer(Sink* sink, uint8_t ref, uint8_t outputClass);
+#endif
+void outputInit();
+void outputService();
+uint8_t outputQueued();
+void sendOutputStatus();
+
+// ============================================================================
+// Replay Buffer (replay.cpp)
+// ============================================================================
+
+extern uint32_t replayRecords;
+extern uint32_t replayPacketsStored;
+extern uint32_t replayPacketsSent;
+extern uint32_t replayPacketsDropped;
+extern volatile uint8_t replayRatio;
+extern volatile bool replayClearRequested;
+
+bool initReplayBuffer();
+void replayAppend(const RxSlot* slot);
+uint32_t replayService(uint32_t maxFrames);
+void replayClear();
+void sendReplayStatus();
+
+// ============================================================================
+// Bluetooth LE (ble.cpp)
+// ============================================================================
+
+extern volatile bool bleConnected;
+extern volatile uint16_t bleConnHandle;
+extern volatile uint16_t bleMtu;
+extern uint32_t blePacketsSent;
+extern uint32_t bleNotifications;
+extern uint32_t bleNotifyErrors;
+extern volatile uint32_t bleLastErrorMs;
+extern uint32_t bleShed;
+
+void initBle();
+#if ENABLE_BLE
+void bleOffer(Sink* sink, uint8_t ref, uint8_t outputClass);
+#endif
+void bleQueuePacket(const RxSlot* slot);
+void bleFlush();
+void bleService();
+bool bleCongested();
+void bleSendText(const char* text, size_t len);
+bool bleReceiveCommand(char* line);
+
+// ============================================================================
+// Wi-Fi UDP Sink (net.cpp)
+// ============================================================================
+
+extern uint32_t netPacketsSent;
+extern std::atomic<uint32_t> netPacketsDropped;
+extern volatile uint8_t netSubscriberCount;
+
+void initNet();
+void handleWifiCommand(const char* args);
+void sendNetStatus();
@@ -0,0 +1,304 @@
+/*
+ * Wi-Fi UDP sink
+ */
+
+#include "modem.h"
+#if ENABLE_WIFI
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#endif
+
+// ============================================================================
+// Wi-Fi UDP Sink
+// ============================================================================
+//
+// Each subscriber is a sink with its own queue of pool references, so a slow
+// client only fills its own queue and loses the packets offered after that;
+// nothing upstream ever waits. The net task batches several v2 frames
+// (FRAME_V2_TAG, per-subscriber SEQ) into each datagram, so a v2 stream parser
+// reads a datagram as-is.
+
+// Wi-Fi sink totals over all subscribers (net task)
+uint32_t netPacketsSent = 0;
+std::atomic<uint32_t> netPacketsDropped(0);   // Refused by a full subscriber queue or lost in a failed send
+volatile uint8_t netSubscriberCount = 0;
+
+#if ENABLE_WIFI
+struct NetSubscriber {
+    Sink sink;
+    volatile bool active;
+    IPAddress ip;
+    uint16_t port;
+    uint32_t lastSeenMs;
+    uint8_t queue[SINK_NET_QUEUE_LEN];  // Sink pool references
+    std::atomic<uint32_t> queueHead;    // Free-running, written by the forward task
+    std::atomic<uint32_t> queueTail;    // Free-running, written by the net task
+    uint32_t seq;                       // v2 SEQ; a gap is loss to this subscriber
+    uint32_t datagrams;
+    uint16_t batchLen;
+    uint16_t batchFrames;
+    uint32_t batchStartMs;
+    int64_t batchRxMicros[NET_BATCH_FRAMES_MAX];
+    uint16_t batchPacketLen[NET_BATCH_FRAMES_MAX];
+    uint8_t batch[NET_DATAGRAM_MAX];
+};
+
+NetSubscriber netSubscribers[NET_MAX_SUBSCRIBERS];
+char netSinkNames[NET_MAX_SUBSCRIBERS][6];
+TaskHandle_t netTaskHandle = nullptr;
+WiFiUDP netUdp;
+bool netUdpOpen = false;                // Net task only
+uint8_t netFrame[FRAME_MAX_SIZE];       // Net task only
+
+// Forward task: queue a reference unless this subscriber is already a full queue behind
+static void netOffer(Sink* sink, uint8_t ref, uint8_t outputClass) {
+    NetSubscriber* sub = (NetSubscriber*)sink->ctx;
+    if (!sub->active) return;
+    uint32_t head = sub->queueHead.load(std::memory_order_relaxed);
+    if (head - sub->queueTail.load(std::memory_order_acquire) >= SINK_NET_QUEUE_LEN) {
+        sink->dropped++;
+        netPacketsDropped++;
+        return;
+    }
+    sinkRetain(ref);
+    sub->queue[head & (SINK_NET_QUEUE_LEN - 1)] = ref;
+    sub->queueHead.store(head + 1, std::memory_order_release);
+    sink->accepted++;
+    xTaskNotifyGive(netTaskHandle);
+}
+
+static void netFlush(NetSubscriber* sub) {
+    if (sub->batchLen == 0) return;
+    bool ok = netUdp.beginPacket(sub->ip, sub->port) &&
+              netUdp.write(sub->batch, sub->batchLen) == sub->batchLen &&
+              netUdp.endPacket();
+    if (ok) {
+        sub->datagrams++;
+        for (uint16_t i = 0; i < sub->batchFrames; i++) {
+            sinkDelivered(&sub->sink, sub->batchPacketLen[i], sub->batchRxMicros[i]);
+        }
+        netPacketsSent += sub->batchFrames;
+    } else {
+        sub->sink.lost += sub->batchFrames;
+        netPacketsDropped += sub->batchFrames;
+    }
+    sub->batchLen = 0;
+    sub->batchFrames = 0;
+}
+
+// Give back everything still held for a subscriber that went away. Run on every
+// pass while inactive: the forward task may queue one more packet as it leaves.
+static void netDiscard(NetSubscriber* sub) {
+    uint32_t head = sub->queueHead.load(std::memory_order_acquire);
+    uint32_t tail = sub->queueTail.load(std::memory_order_relaxed);
+    for (; tail != head; tail++) {
+        sinkRelease(sub->queue[tail & (SINK_NET_QUEUE_LEN - 1)]);
+        sub->sink.lost++;
+    }
+    sub->queueTail.store(tail, std::memory_order_release);
+    sub->sink.lost += sub->batchFrames;
+    sub->batchLen = 0;
+    sub->batchFrames = 0;
+}
+
+static void netServiceSubscriber(NetSubscriber* sub) {
+    uint32_t head = sub->queueHead.load(std::memory_order_acquire);
+    uint32_t tail = sub->queueTail.load(std::memory_order_relaxed);
+    while (tail != head) {
+        uint8_t ref = sub->queue[tail & (SINK_NET_QUEUE_LEN - 1)];
+        const RxSlot* slot = sinkSlot(ref);
+        size_t len = buildFrameV2(netFrame, slot, sub->seq);
+
+        if (sub->batchLen + len > NET_DATAGRAM_MAX || sub->batchFrames == NET_BATCH_FRAMES_MAX) netFlush(sub);
+        if (sub->batchLen == 0) sub->batchStartMs = millis();
+        memcpy(sub->batch + sub->batchLen, netFrame, len);
+        sub->batchRxMicros[sub->batchFrames] = slot->rxMicros;
+        sub->batchPacketLen[sub->batchFrames] = slot->len;
+        sub->batchLen += len;
+        sub->batchFrames++;
+        sub->seq++;
+
+        // The frame owns a copy now; hand the slot and the queue entry back right away
+        sinkRelease(ref);
+        tail++;
+        sub->queueTail.store(tail, std::memory_order_release);
+    }
+
+    // Send when another worst-case frame wouldn't fit, or the oldest frame has waited long enough
+    if (sub->batchLen > 0 && (sub->batchLen + FRAME_MAX_SIZE > NET_DATAGRAM_MAX ||
+                              millis() - sub->batchStartMs >= NET_BATCH_MS)) {
+        netFlush(sub);
+    }
+}
+
+// "SUB" subscribes (or refreshes) the sender, "UNSUB" removes it
+static void netReceiveControl() {
+    while (netUdp.parsePacket() > 0) {
+        char msg[8];
+        int n = netUdp.read((uint8_t*)msg, sizeof(msg) - 1);
+        if (n <= 0) continue;
+        while (n > 0 && (msg[n - 1] == '\n' || msg[n - 1] == '\r')) n--;
+        msg[n] = '\0';
+        IPAddress ip = netUdp.remoteIP();
+        uint16_t port = netUdp.remotePort();
+
+        NetSubscriber* match = nullptr;
+        NetSubscriber* free = nullptr;
+        for (int i = 0; i < NET_MAX_SUBSCRIBERS; i++) {
+            NetSubscriber* sub = &netSubscribers[i];
+            if (sub->active && sub->ip == ip && sub->port == port) match = sub;
+            if (!sub->active && free == nullptr) free = sub;
+        }
+
+        const char* reply = nullptr;
+        if (strcmp(msg, "SUB") == 0) {
+            if (match == nullptr && free != nullptr) {
+                match = free;
+                netDiscard(match);      // Live from now
+                sinkReset(&match->sink);
+                match->ip = ip;
+                match->port = port;
+                match->seq = 0;
+                match->datagrams = 0;
+                match->active = true;
+                netSubscriberCount++;
+            }
+            if (match != nullptr) match->lastSeenMs = millis();
+            reply = match != nullptr ? "SUB_OK" : "SUB_ERR:Full";
+        } else if (strcmp(msg, "UNSUB") == 0 && match != nullptr) {
+            match->active = false;
+            netSubscriberCount--;
+            reply = "UNSUB_OK";
+        }
+        if (reply != nullptr && netUdp.beginPacket(ip, port)) {
+            netUdp.write((const uint8_t*)reply, strlen(reply));
+            netUdp.endPacket();
+        }
+    }
+}
+
+static void netTask(void* param) {
+    for (;;) {
+        // Batch deadline while anyone is subscribed, otherwise just often enough to see SUB
+        TickType_t wait = netSubscriberCount > 0 ? NET_BATCH_MS : (netUdpOpen ? NET_IDLE_POLL_MS : NET_DOWN_POLL_MS);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+
+        // Reopen the socket across reconnects; subscribers re-send SUB themselves
+        bool connected = WiFi.status() == WL_CONNECTED;
+        if (connected != netUdpOpen) {
+            if (connected) {
+                netUdpOpen = netUdp.begin(NET_UDP_PORT);
+            } else {
+                netUdp.stop();
+                netUdpOpen = false;
+            }
+            for (int i = 0; i < NET_MAX_SUBSCRIBERS; i++) {
+                netSubscribers[i].active = false;
+                netDiscard(&netSubscribers[i]);
+            }
+            netSubscriberCount = 0;
+        }
+        if (!netUdpOpen) continue;
+
+        netReceiveControl();
+        uint32_t now = millis();
+        for (int i = 0; i < NET_MAX_SUBSCRIBERS; i++) {
+            NetSubscriber* sub = &netSubscribers[i];
+            if (!sub->active) {
+                netDiscard(sub);
+                continue;
+            }
+            if (now - sub->lastSeenMs > NET_SUBSCRIBER_TIMEOUT_MS) {
+                netFlush(sub);
+                sub->active = false;
+                netSubscriberCount--;
+                continue;
+            }
+            netServiceSubscriber(sub);
+        }
+    }
+}
+
+static void netConnect(const char* ssid, const char* pass) {
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(true);
+    // Modem sleep stays on: it is required while BLE shares the radio
+    WiFi.begin(ssid, pass);
+    logPrintf("[NET] Connecting to %s\n", ssid);
+}
+
+// Starts the net task; joins the saved network, if any. Nothing radio-side depends on it.
+void initNet() {
+    if (xTaskCreatePinnedToCore(netTask, "net", NET_TASK_STACK, nullptr,
+                                NET_TASK_PRIORITY, &netTaskHandle, NET_TASK_CORE) != pdPASS) {
+        logPrintf("[NET] Task start failed - Wi-Fi sink disabled\n");
+        return;
+    }
+    for (int i = 0; i < NET_MAX_SUBSCRIBERS; i++) {
+        snprintf(netSinkNames[i], sizeof(netSinkNames[i]), "NET%d", i);
+        sinkRegister(&netSubscribers[i].sink, netSinkNames[i], netOffer, &netSubscribers[i]);
+    }
+
+    char ssid[NET_SSID_MAX] = "";
+    char pass[NET_PASS_MAX] = "";
+    if (prefs.begin(NVS_NAMESPACE, true)) {
+        prefs.getString(NVS_KEY_WIFI_SSID, ssid, sizeof(ssid));
+        prefs.getString(NVS_KEY_WIFI_PASS, pass, sizeof(pass));
+        prefs.end();
+    }
+    if (ssid[0] != '\0') netConnect(ssid, pass);
+}
+
+// WIFI:<ssid>,<password> joins and saves a network, WIFI:OFF disconnects and forgets it
+void handleWifiCommand(const char* args) {
+    if (strcmp(args, "OFF") == 0) {
+        WiFi.disconnect(true);
+        if (prefs.begin(NVS_NAMESPACE, false)) {
+            prefs.remove(NVS_KEY_WIFI_SSID);
+            prefs.remove(NVS_KEY_WIFI_PASS);
+            prefs.end();
+        }
+        hostPrintf("WIFI_OK:off\n");
+        return;
+    }
+
+    const char* comma = strchr(args, ',');
+    size_t ssidLen = comma ? (size_t)(comma - args) : strlen(args);
+    if (ssidLen == 0 || ssidLen >= NET_SSID_MAX || (comma && strlen(comma + 1) >= NET_PASS_MAX)) {
+        hostPrintf("WIFI_ERR:Expected <ssid>,<password>\n");
+        return;
+    }
+    char ssid[NET_SSID_MAX];
+    memcpy(ssid, args, ssidLen);
+    ssid[ssidLen] = '\0';
+    const char* pass = comma ? comma + 1 : "";
+
+    if (prefs.begin(NVS_NAMESPACE, false)) {
+        prefs.putString(NVS_KEY_WIFI_SSID, ssid);
+        prefs.putString(NVS_KEY_WIFI_PASS, pass);
+        prefs.end();
+    }
+    WiFi.disconnect();
+    netConnect(ssid, pass);
+    hostPrintf("WIFI_OK:connecting %s\n", ssid);
+}
+
+void sendNetStatus() {
+    bool connected = WiFi.status() == WL_CONNECTED;
+    IPAddress ip = WiFi.localIP();
+    hostPrintf("WIFI_OK:%s ip=%u.%u.%u.%u port=%d rssi=%d subs=%u sent=%lu drop=%lu\n",
+               connected ? "up" : "down", ip[0], ip[1], ip[2], ip[3], NET_UDP_PORT,
+               connected ? WiFi.RSSI() : 0, netSubscriberCount, netPacketsSent, netPacketsDropped.load());
+    for (int i = 0; i < NET_MAX_SUBSCRIBERS; i++) {
+        const NetSubscriber* sub = &netSubscribers[i];
+        if (!sub->active) continue;
+        hostPrintf("[NET] %u.%u.%u.%u:%u sent=%lu drop=%lu dgrams=%lu\n",
+                   sub->ip[0], sub->ip[1], sub->ip[2], sub->ip[3], sub->port,
+                   sub->sink.sent, sub->sink.dropped + sub->sink.lost, sub->datagrams);
+    }
+}
+#else
+void initNet() {}
+void handleWifiCommand(const char* args) { hostPrintf("WIFI_ERR:Built without Wi-Fi\n"); }
+void sendNetStatus() { hostPrintf("WIFI_ERR:Built without Wi-Fi\n"); }
+#endif
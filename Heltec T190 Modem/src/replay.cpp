@@ -0,0 +1,172 @@
+/*
+ * Store-and-forward replay buffer for the USB sink
+ */
+
+#include "modem.h"
+
+// ============================================================================
+// Store-and-Forward Replay Buffer
+// ============================================================================
+//
+// Variable-length records in one PSRAM byte ring:
+//   [LEN:2][RSVD:2][RSSI:f32][SNR:f32][RX_US:i64][DATA...] padded to 4 bytes
+// A record never wraps; when it doesn't fit before the end a LEN of
+// REPLAY_WRAP_MARKER (or too few bytes left for a header) sends the reader back
+// to offset 0. When full, the oldest records are evicted. Only the forward task
+// touches the ring, so there is no locking.
+
+// Replay backlog (owned by the forward task; read elsewhere for stats only)
+uint32_t replayRecords = 0;
+uint32_t replayPacketsStored = 0;
+uint32_t replayPacketsSent = 0;
+uint32_t replayPacketsDropped = 0;      // Oldest records evicted to make room
+volatile uint8_t replayRatio = REPLAY_DEFAULT_RATIO;
+volatile bool replayClearRequested = false;
+
+#if ENABLE_USB
+
+uint8_t* replayBuf = nullptr;
+size_t replayCapacity = 0;
+size_t replayHead = 0;          // Next write offset
+size_t replayTail = 0;          // Oldest record
+size_t replayUsed = 0;          // Bytes between tail and head, wrap padding included
+RxSlot replaySlot;              // Record being replayed
+
+static inline size_t replayRecordSize(uint16_t len) {
+    return (REPLAY_RECORD_HEADER + len + 3) & ~(size_t)3;
+}
+
+bool initReplayBuffer() {
+    size_t sizes[] = { REPLAY_BUFFER_BYTES, REPLAY_BUFFER_FALLBACK };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]) && psramFound(); i++) {
+        replayBuf = (uint8_t*)ps_malloc(sizes[i]);
+        if (replayBuf) {
+            replayCapacity = sizes[i];
+            logPrintf("[RPL] Replay buffer %u KB in PSRAM\n", (unsigned)(replayCapacity / 1024));
+            return true;
+        }
+    }
+    return false;
+}
+
+// Step the tail over a wrap marker so it points at a real record
+static void replaySkipWrap() {
+    if (replayUsed == 0) return;
+    uint16_t len = REPLAY_WRAP_MARKER;
+    if (replayCapacity - replayTail >= REPLAY_RECORD_HEADER) {
+        memcpy(&len, replayBuf + replayTail, sizeof(len));
+    }
+    if (len == REPLAY_WRAP_MARKER) {
+        replayUsed -= replayCapacity - replayTail;
+        replayTail = 0;
+    }
+}
+
+// Drop the oldest record; false if there was none, only wrap padding
+static bool replayPop() {
+    replaySkipWrap();
+    if (replayUsed == 0) return false;
+    uint16_t len;
+    memcpy(&len, replayBuf + replayTail, sizeof(len));
+    size_t size = replayRecordSize(len);
+    replayTail += size;
+    replayUsed -= size;
+    replayRecords--;
+    if (replayUsed == 0) replayHead = replayTail = 0;
+    return true;
+}
+
+void replayAppend(const RxSlot* slot) {
+    size_t need = replayRecordSize(slot->len);
+    if (replayBuf == nullptr || need > replayCapacity) {
+        replayPacketsDropped++;
+        usbSink.lost++;
+        return;
+    }
+
+    // Find contiguous room at the head, evicting oldest records as needed
+    for (;;) {
+        if (replayUsed == 0) {
+            replayHead = replayTail = 0;
+            break;
+        }
+        if (replayHead > replayTail || (replayHead == replayTail && replayUsed < replayCapacity)) {
+            if (replayCapacity - replayHead >= need) break;
+            if (replayCapacity - replayHead >= sizeof(uint16_t)) {
+                uint16_t marker = REPLAY_WRAP_MARKER;
+                memcpy(replayBuf + replayHead, &marker, sizeof(marker));
+            }
+            replayUsed += replayCapacity - replayHead;
+            replayHead = 0;
+            continue;
+        }
+        if (replayHead < replayTail && replayTail - replayHead >= need) break;
+        if (replayPop()) {
+            replayPacketsDropped++;
+            usbSink.lost++;
+        }
+    }
+
+    uint8_t* p = replayBuf + replayHead;
+    uint16_t reserved = 0;
+    memcpy(p, &slot->len, 2);
+    memcpy(p + 2, &reserved, 2);
+    memcpy(p + 4, &slot->rssi, 4);
+    memcpy(p + 8, &slot->snr, 4);
+    memcpy(p + 12, &slot->rxMicros, 8);
+    memcpy(p + REPLAY_RECORD_HEADER, slot->data, slot->len);
+
+    replayHead += need;
+    replayUsed += need;
+    replayRecords++;
+    replayPacketsStored++;
+    if (replayRecords > replayHighWater) replayHighWater = replayRecords;
+}
+
+// Oldest record into replaySlot; false if the backlog is empty
+static bool replayPeek() {
+    replaySkipWrap();
+    if (replayUsed == 0) return false;
+    const uint8_t* p = replayBuf + replayTail;
+    memcpy(&replaySlot.len, p, 2);
+    memcpy(&replaySlot.rssi, p + 4, 4);
+    memcpy(&replaySlot.snr, p + 8, 4);
+    memcpy(&replaySlot.rxMicros, p + 12, 8);
+    memcpy(replaySlot.data, p + REPLAY_RECORD_HEADER, replaySlot.len);
+    return true;
+}
+
+// Replay up to maxFrames of backlog, oldest first, stopping as soon as the CDC
+// buffer is full. Frames keep their original RX timestamp (visible in frame v2).
+uint32_t replayService(uint32_t maxFrames) {
+    uint32_t sent = 0;
+    while (sent < maxFrames && replayPeek()) {
+        if (!usbWriteFrame(&replaySlot)) break;
+        sinkDelivered(&usbSink, replaySlot.len, replaySlot.rxMicros);
+        replayPop();
+        replayPacketsSent++;
+        sent++;
+    }
+    return sent;
+}
+
+void replayClear() {
+    replayPacketsDropped += replayRecords;
+    usbSink.lost += replayRecords;
+    replayRecords = 0;
+    replayHead = replayTail = replayUsed = 0;
+}
+
+// Backlog summary: records, bytes used/capacity, age of the oldest record, counters
+void sendReplayStatus() {
+    uint32_t records = replayRecords;
+    size_t used = replayUsed;
+    hostPrintf("RPL_OK:n=%lu used=%uKB/%uKB stored=%lu sent=%lu drop=%lu ratio=%u\n",
+               records, (unsigned)(used / 1024), (unsigned)(replayCapacity / 1024),
+               replayPacketsStored, replayPacketsSent, replayPacketsDropped, replayRatio);
+}
+#else
+bool initReplayBuffer() { return true; }
+void replayClear() {}
+void sendReplayStatus() { hostPrintf("RPL_ERR:Built without the USB sink\n"); }
+#endif
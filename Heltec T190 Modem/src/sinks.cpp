@@ -0,0 +1,169 @@
+/*
+ * Output sinks: one shared packet pool, offered to every transport
+ */
+
+#include "modem.h"
+
+// ============================================================================
+// Output Sinks
+// ============================================================================
+//
+// A validated packet is copied once into sinkPool and offered to every
+// sink (USB, BLE, each Wi-Fi subscriber). USB and BLE are fixed at build
+// time (ENABLE_USB / ENABLE_BLE) and reached through the BuildSinks chain;
+// Wi-Fi subscribers come and go, so they are walked in sinkTable. A sink that takes it
+// keeps a reference in its own bounded queue and releases it once its
+// transport has the bytes; a sink that can't take it counts the drop. A
+// stalled transport therefore only loses its own packets. The pool has one
+// entry more than all sink queues together, so the forward task always finds
+// a free one.
+
+SinkPacket sinkPool[SINK_POOL_SLOTS];
+uint8_t sinkPoolNext = 0;                   // Forward task only
+Sink* sinkTable[SINK_MAX];
+std::atomic<uint8_t> sinkCount(0);
+Sink usbSink;
+Sink bleSink;
+
+void sinkReset(Sink* sink) {
+    sink->accepted = 0;
+    sink->dropped = 0;
+    sink->sent = 0;
+    sink->lost = 0;
+    sink->bytes = 0;
+    memset(&sink->latency, 0, sizeof(sink->latency));
+    sink->latency.name = sink->name;
+}
+
+// Sinks are only ever added, so the forward task can walk the table while setup() registers more.
+// Fixed sinks register with offer == nullptr, to be listed by SINKS?; BuildSinks offers to them.
+void sinkRegister(Sink* sink, const char* name, SinkOfferFn offer, void* ctx) {
+    uint8_t count = sinkCount.load(std::memory_order_relaxed);
+    if (count >= SINK_MAX) return;
+    sink->name = name;
+    sink->offer = offer;
+    sink->ctx = ctx;
+    sink->imageMode = IMAGE_MODE_RAW;
+    sinkReset(sink);
+    sinkTable[count] = sink;
+    sinkCount.store(count + 1, std::memory_order_release);
+}
+
+// One fixed sink as a BuildSinks stage
+template <Sink* S, SinkOfferFn Offer>
+struct FixedSink {
+    static inline void offer(uint8_t ref, uint8_t outputClass, bool imageRebuilt) {
+        // A sink fed decoded images has no use for more symbols of one it has been sent
+        if (imageRebuilt && S->imageMode == IMAGE_MODE_IMAGE) return;
+        Offer(S, ref, outputClass);
+    }
+};
+
+// The sinks registered at run time (Wi-Fi subscribers), always raw symbols
+struct TableSinks {
+    static inline void offer(uint8_t ref, uint8_t outputClass, bool imageRebuilt) {
+        uint8_t count = sinkCount.load(std::memory_order_acquire);
+        for (uint8_t i = 0; i < count; i++) {
+            if (sinkTable[i]->offer != nullptr) sinkTable[i]->offer(sinkTable[i], ref, outputClass);
+        }
+    }
+};
+
+#if ENABLE_WIFI
+typedef SinkChain<TableSinks, SinkNone> NetSinkSet;
+#else
+typedef SinkNone NetSinkSet;
+#endif
+#if ENABLE_BLE
+typedef SinkChain<FixedSink<&bleSink, bleOffer>, NetSinkSet> BleSinkSet;
+#else
+typedef NetSinkSet BleSinkSet;
+#endif
+#if ENABLE_USB
+typedef SinkChain<FixedSink<&usbSink, usbOffer>, BleSinkSet> BuildSinks;
+#else
+typedef BleSinkSet BuildSinks;
+#endif
+
+// Forward task: one copy into the pool, then a reference offered to each sink
+void sinkPublish(const RxSlot* slot, uint8_t outputClass, bool imageRebuilt) {
+    uint8_t ref = SINK_NO_REF;
+    for (int i = 0; i < SINK_POOL_SLOTS && ref == SINK_NO_REF; i++) {
+        if (sinkPool[sinkPoolNext].refs.load(std::memory_order_acquire) == 0) ref = sinkPoolNext;
+        sinkPoolNext = (sinkPoolNext + 1) % SINK_POOL_SLOTS;
+    }
+    if (ref == SINK_NO_REF) return;     // Unreachable with the pool sized as above
+
+    SinkPacket* entry = &sinkPool[ref];
+    entry->slot.rxMicros = slot->rxMicros;
+    entry->slot.len = slot->len;
+    entry->slot.rssi = slot->rssi;
+    entry->slot.snr = slot->snr;
+    entry->slot.injected = slot->injected;
+    memcpy(entry->slot.data, slot->data, slot->len);
+    entry->refs.store(1, std::memory_order_relaxed);   // Held by the publisher until every sink had its turn
+
+    BuildSinks::offer(ref, outputClass, imageRebuilt);
+    sinkRelease(ref);
+}
+
+void sendSinkStatus() {
+    uint8_t count = sinkCount.load(std::memory_order_acquire);
+    unsigned inUse = 0;
+    for (int i = 0; i < SINK_POOL_SLOTS; i++) {
+        if (sinkPool[i].refs.load(std::memory_order_relaxed) != 0) inUse++;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        const Sink* sink = sinkTable[i];
+        const LatencyHistogram* h = &sink->latency;
+        hostPrintf("[SINK] %s acc=%lu sent=%lu drop=%lu lost=%lu bytes=%lu avg=%lu p99<=%lu max=%lu us\n",
+                   sink->name, sink->accepted, sink->sent, sink->dropped, sink->lost, sink->bytes,
+                   h->count ? (uint32_t)(h->totalUs / h->count) : 0, latencyPercentile(h, 99), h->maxUs);
+    }
+    hostPrintf("SINKS_OK:n=%u pool=%u/%u\n", count, inUse, (unsigned)SINK_POOL_SLOTS);
+}
+
+static const char* const IMAGE_MODE_NAMES[] = { "RAW", "IMAGE", "BOTH" };
+
+// IMG:OUT:<USB|BLE>,<RAW|IMAGE|BOTH>; Wi-Fi subscribers always get raw symbols
+void handleImageOutputCommand(const char* args) {
+    const char* comma = strchr(args, ',');
+    Sink* sink = nullptr;
+    uint8_t output = 0;
+    if (comma && comma - args == 3 && strncmp(args, "USB", 3) == 0) {
+        sink = &usbSink;
+        output = IMAGE_OUTPUT_USB;
+    } else if (comma && comma - args == 3 && strncmp(args, "BLE", 3) == 0) {
+        sink = &bleSink;
+        output = IMAGE_OUTPUT_BLE;
+    }
+    int mode = -1;
+    for (int m = 0; sink && m < 3; m++) {
+        if (strcmp(comma + 1, IMAGE_MODE_NAMES[m]) == 0) mode = m;
+    }
+    if (mode < 0) {
+        hostPrintf("IMG_ERR:Expected OUT:<USB|BLE>,<RAW|IMAGE|BOTH>\n");
+        return;
+    }
+    if (sink->name == nullptr) {
+        hostPrintf("IMG_ERR:%.3s sink not in this build\n", args);
+        return;
+    }
+    if (mode != IMAGE_MODE_RAW && imageReconPool == nullptr) {
+        hostPrintf("IMG_ERR:No PSRAM for reconstruction\n");
+        return;
+    }
+
+    sink->imageMode = mode;
+    uint8_t outputs = 0;
+    if (usbSink.imageMode != IMAGE_MODE_RAW) outputs |= 1 << IMAGE_OUTPUT_USB;
+    if (bleSink.imageMode != IMAGE_MODE_RAW) outputs |= 1 << IMAGE_OUTPUT_BLE;
+    imageOutputs.store(outputs, std::memory_order_relaxed);
+    hostPrintf("IMG_OK:%s=%s\n", output == IMAGE_OUTPUT_USB ? "USB" : "BLE", IMAGE_MODE_NAMES[mode]);
+}
+
+void sendImageOutputStatus() {
+    hostPrintf("IMG_OK:usb=%s ble=%s decoded=%lu failed=%lu sent=%lu/%lu\n",
+               IMAGE_MODE_NAMES[usbSink.imageMode], IMAGE_MODE_NAMES[bleSink.imageMode],
+               imagesDecoded, imagesFailed, imagesSent[IMAGE_OUTPUT_USB], imagesSent[IMAGE_OUTPUT_BLE]);
+}
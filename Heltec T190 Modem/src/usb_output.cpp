@@ -0,0 +1,346 @@
+/*
+ * USB packet output: CDC or vendor-link frames and the output scheduler
+ */
+
+#include "modem.h"
+#if USB_VENDOR_LINK
+#include <USB.h>
+#include <USBVendor.h>
+#endif
+
+// ============================================================================
+// USB Packet Forwarding
+// ============================================================================
+
+// Output scheduler
+uint32_t packetsShed = 0;               // Image symbols dropped at the USB watermark
+volatile uint8_t outputWatermark = OUTPUT_DEFAULT_WATERMARK;
+volatile bool usbHostAway = false;
+
+#if ENABLE_USB
+
+// Owned by the forward task; sized for a packet or image chunk frame where every byte needs stuffing
+#define USB_FRAME_BUFFER_SIZE   (FRAME_TAGGED_MAX_SIZE(IMAGE_CHUNK_HEADER + IMAGE_CHUNK_BYTES) > FRAME_MAX_SIZE ? \
+                                 FRAME_TAGGED_MAX_SIZE(IMAGE_CHUNK_HEADER + IMAGE_CHUNK_BYTES) : FRAME_MAX_SIZE)
+uint8_t frameBuffer[USB_FRAME_BUFFER_SIZE];
+int64_t usbBlockedSince = 0;        // First failed write since the last success, 0 if none
+
+#if USB_VENDOR_LINK
+// With the OTG controller the modem enumerates as a composite device: the CDC
+// port keeps commands, logs and text replies, and a vendor-class interface
+// (class 0xFF, one bulk IN/OUT pair) carries the frames once a host has opened
+// it by writing anything to its OUT endpoint. Until then, and after the host
+// goes away, frames stay on the CDC port. The vendor FIFO may be smaller than
+// a frame, so whatever doesn't fit stays in frameBuffer and goes out before
+// the next frame is built; a frame is never torn.
+USBVendor vendorLink;
+volatile bool vendorHostOpen = false;   // Set by the TinyUSB event task, cleared by either
+size_t vendorPendingOff = 0;            // Forward task: unsent tail of frameBuffer
+size_t vendorPendingLen = 0;
+int64_t vendorStalledSince = 0;         // Forward task: first write the FIFO took nothing of, 0 if none
+uint32_t vendorFrames = 0;
+uint32_t vendorCloses = 0;              // Host stopped reading for VENDOR_CLOSE_MS
+
+static void vendorLinkEvent(void* arg, esp_event_base_t base, int32_t id, void* data) {
+    if (base == ARDUINO_USB_VENDOR_EVENTS && id == ARDUINO_USB_VENDOR_DATA_EVENT) {
+        // The host opened the interface; what it sent carries no meaning
+        while (vendorLink.available() > 0) vendorLink.read();
+        vendorHostOpen = true;
+        if (forwardTaskHandle != nullptr) xTaskNotifyGive(forwardTaskHandle);
+    } else if (base == ARDUINO_USB_EVENTS &&
+               (id == ARDUINO_USB_STOPPED_EVENT || id == ARDUINO_USB_SUSPEND_EVENT)) {
+        vendorHostOpen = false;
+    }
+}
+
+// The vendor interface is registered by the USBVendor constructor, before the stack starts
+void initVendorLink() {
+    vendorLink.onEvent(vendorLinkEvent);
+    USB.onEvent(vendorLinkEvent);
+    vendorLink.begin();
+    USB.begin();
+}
+
+// Forward task: true while frames go to the vendor interface. A half-sent frame
+// is dropped when the link changes so the next host never sees its tail.
+static bool vendorLinkActive() {
+    static bool active = false;
+    bool open = vendorHostOpen && vendorLink.mounted();
+    if (open != active) {
+        active = open;
+        vendorPendingOff = vendorPendingLen = 0;
+        vendorStalledSince = 0;
+    }
+    return active;
+}
+
+// A vendor interface has no open/close signal: a host that closed its handle just
+// stops reading. Once the FIFO has taken nothing for VENDOR_CLOSE_MS, frames go
+// back to the CDC port until the host writes to the OUT endpoint again.
+static void vendorWriteProgress(size_t written) {
+    if (written > 0) {
+        vendorStalledSince = 0;
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (vendorStalledSince == 0) {
+        vendorStalledSince = now;
+    } else if (now - vendorStalledSince > VENDOR_CLOSE_MS * 1000LL) {
+        vendorHostOpen = false;
+        vendorCloses++;
+    }
+}
+
+// Push the tail of the last frame; true once nothing of it is left
+static bool vendorDrainPending() {
+    if (vendorPendingOff < vendorPendingLen) {
+        size_t n = vendorLink.write(frameBuffer + vendorPendingOff, vendorPendingLen - vendorPendingOff);
+        vendorPendingOff += n;
+        vendorWriteProgress(n);
+    }
+    return vendorPendingOff == vendorPendingLen;
+}
+#endif
+
+// Any CDC event (connect, line state, RX, TX drained) may be the host coming back for its backlog
+static void usbHostEvent(void* arg, esp_event_base_t base, int32_t id, void* data) {
+    if (usbHostAway && forwardTaskHandle != nullptr) xTaskNotifyGive(forwardTaskHandle);
+}
+
+void initUsbHostEvents() {
+    Serial.onEvent(usbHostEvent);
+}
+
+static inline bool usbLinkUp() {
+#if USB_VENDOR_LINK
+    if (vendorLinkActive()) return true;
+#endif
+    return (bool)Serial;
+}
+
+// Send what sits in the vendor FIFO as one transfer; the CDC driver drains on its own
+void usbFlush() {
+#if USB_VENDOR_LINK
+    if (vendorLinkActive()) vendorLink.flush();
+#endif
+}
+
+static bool usbWriteDone(bool complete) {
+    if (complete) {
+        usbBlockedSince = 0;
+        usbHostAway = false;
+        return true;
+    }
+    if (usbBlockedSince == 0) usbBlockedSince = esp_timer_get_time();
+    return false;
+}
+
+// Whether frameBuffer may be rebuilt: the vendor FIFO took the whole last frame
+static bool usbWriteReady() {
+#if USB_VENDOR_LINK
+    if (vendorLinkActive() && !vendorDrainPending()) return false;
+#endif
+    return true;
+}
+
+// Hand the frame in frameBuffer to the link; returns the bytes written, all or nothing on CDC
+static size_t usbWriteBuffer(size_t frameLen) {
+    size_t written = 0;
+#if USB_VENDOR_LINK
+    if (vendorLinkActive()) {
+        // Once any of it is in the FIFO the frame is committed; the rest follows before the next one
+        written = vendorLink.write(frameBuffer, frameLen);
+        vendorWriteProgress(written);
+        if (written > 0) {
+            vendorPendingOff = written;
+            vendorPendingLen = frameLen;
+            written = frameLen;
+            vendorFrames++;
+        }
+    } else
+#endif
+    {
+        // One bulk write into the CDC TX buffer; no flush, the driver drains it
+        xSemaphoreTake(serialMutex, portMAX_DELAY);
+        written = serialWriteFrame(frameBuffer, frameLen);
+        xSemaphoreGive(serialMutex);
+    }
+    return written;
+}
+
+// Frame one packet and hand it to the CDC driver only if the whole frame fits. A host
+// that stopped reading (unplugged, asleep, port closed) leaves the TX buffer full, and
+// waiting on it would back up the RX ring. Returns false unless the full frame went out.
+bool usbWriteFrame(const RxSlot* slot) {
+    // Modem-side frame counter; a gap seen by the host means loss on the serial link
+    static uint32_t frameSequence = 0;
+    uint8_t format = hostFrameFormat;
+    if (!usbWriteReady()) return usbWriteDone(false);
+
+    size_t frameLen;
+    if (format == 2) {
+        frameLen = buildFrameV2(frameBuffer, slot, frameSequence);
+    } else {
+        frameLen = buildFrame(frameBuffer, slot->data, slot->len, slot->rssi, slot->snr);
+    }
+    size_t written = usbWriteBuffer(frameLen);
+
+    // A torn frame still used its sequence number; the host drops it on CRC
+    if (written > 0 && format == 2) frameSequence++;
+
+    return usbWriteDone(written == frameLen);
+}
+
+// Decoded images go out as consecutive FRAME_IMAGE_TAG chunks whenever no live frame is waiting.
+// Not counted as host progress: a host that only takes these is not holding up packets.
+static void usbImageService() {
+    static uint8_t chunk[IMAGE_CHUNK_HEADER + IMAGE_CHUNK_BYTES];
+    while (usbWriteReady()) {
+        size_t len = imageChunkPeek(IMAGE_OUTPUT_USB, chunk, IMAGE_CHUNK_BYTES);
+        if (len == 0) return;
+        size_t frameLen = buildTaggedFrame(frameBuffer, FRAME_IMAGE_TAG, chunk, len);
+        if (usbWriteBuffer(frameLen) != frameLen) return;
+        imageChunkSent(IMAGE_OUTPUT_USB, len);
+    }
+}
+
+void sendLinkStatus() {
+#if USB_VENDOR_LINK
+    bool vendor = vendorHostOpen && vendorLink.mounted();
+    hostPrintf("LINK_OK:%s mounted=%d frames=%lu closed=%lu\n", vendor ? "vendor" : "cdc",
+               vendorLink.mounted() ? 1 : 0, vendorFrames, vendorCloses);
+#else
+    hostPrintf("LINK_OK:cdc\n");
+#endif
+}
+
+// ============================================================================
+// Output Scheduler
+// ============================================================================
+//
+// The USB sink. Validated packets wait as pool references for room in the CDC
+// TX buffer. Each class has its own FIFO and the priority class is always
+// drained first, so a position fix never sits behind a burst of image symbols.
+// Under backpressure image symbols are shed once outputWatermark frames are
+// queued; if the host makes no progress for OUTPUT_HOST_STALL_MS everything
+// goes to the replay buffer instead. All of it is owned by the forward task.
+
+struct OutputQueue {
+    uint8_t slots[OUTPUT_POOL_SLOTS];   // Sink pool references, oldest at head
+    uint8_t head;
+    uint8_t count;
+};
+
+OutputQueue outputQueues[OUTPUT_CLASS_COUNT];
+
+uint8_t outputQueued() {
+    return outputQueues[OUTPUT_CLASS_PRIORITY].count + outputQueues[OUTPUT_CLASS_BULK].count;
+}
+
+static uint8_t outputPop(uint8_t cls) {
+    OutputQueue* q = &outputQueues[cls];
+    uint8_t ref = q->slots[q->head];
+    q->head = (q->head + 1) % OUTPUT_POOL_SLOTS;
+    q->count--;
+    return ref;
+}
+
+// Host gone: move every queued frame to the replay buffer, priority class first
+static void outputSpillToReplay() {
+    for (uint8_t cls = 0; cls < OUTPUT_CLASS_COUNT; cls++) {
+        while (outputQueues[cls].count > 0) {
+            uint8_t ref = outputPop(cls);
+            replayAppend(sinkSlot(ref));
+            sinkRelease(ref);
+        }
+    }
+}
+
+void usbOffer(Sink* sink, uint8_t ref, uint8_t outputClass) {
+    const RxSlot* slot = sinkSlot(ref);
+
+    // Replay writes are what notice the host coming back; with no backlog, probe with live traffic
+    if (usbHostAway && replayRecords == 0) usbHostAway = false;
+    if (usbHostAway) {
+        replayAppend(slot);
+        sink->accepted++;
+        return;
+    }
+
+    if (outputClass == OUTPUT_CLASS_BULK && outputQueued() >= outputWatermark) {
+        packetsShed++;
+        sink->dropped++;
+        return;
+    }
+    if (outputQueued() >= OUTPUT_POOL_SLOTS && outputQueues[OUTPUT_CLASS_BULK].count > 0) {
+        // Priority traffic takes the place of the oldest queued image symbol
+        sinkRelease(outputPop(OUTPUT_CLASS_BULK));
+        packetsShed++;
+        sink->lost++;
+    }
+    sink->accepted++;
+    if (outputQueued() >= OUTPUT_POOL_SLOTS) {
+        replayAppend(slot);
+        return;
+    }
+
+    sinkRetain(ref);
+    OutputQueue* q = &outputQueues[outputClass];
+    q->slots[(q->head + q->count) % OUTPUT_POOL_SLOTS] = ref;
+    q->count++;
+    if (outputQueued() > outputHighWater) outputHighWater = outputQueued();
+
+    outputService();
+}
+
+void outputInit() {
+    memset(outputQueues, 0, sizeof(outputQueues));
+    sinkRegister(&usbSink, "USB", nullptr, nullptr);
+}
+
+// Write queued frames, highest class first, until the CDC buffer is full
+void outputService() {
+    for (;;) {
+        uint8_t cls = outputQueues[OUTPUT_CLASS_PRIORITY].count > 0 ? OUTPUT_CLASS_PRIORITY : OUTPUT_CLASS_BULK;
+        OutputQueue* q = &outputQueues[cls];
+        if (q->count == 0) break;
+
+        const RxSlot* slot = sinkSlot(q->slots[q->head]);
+        int64_t writeStart = esp_timer_get_time();
+        if (!usbWriteFrame(slot)) {
+            if (!usbLinkUp() || esp_timer_get_time() - usbBlockedSince > (int64_t)OUTPUT_HOST_STALL_MS * 1000) {
+                usbHostAway = true;
+                outputSpillToReplay();
+            }
+            return;
+        }
+
+        int64_t now = esp_timer_get_time();
+        latencyRecord(&latUsbWrite, now - writeStart);
+        latencyRecord(&latEndToEnd, now - slot->rxMicros);
+        sinkDelivered(&usbSink, slot->len, slot->rxMicros);
+        sinkRelease(outputPop(cls));
+
+        // Live traffic first, then up to replayRatio frames of backlog behind it
+        if (replayRecords > 0) replayService(replayRatio);
+    }
+
+    // Nothing live waiting: decoded images, then replay at full link speed until the CDC buffer fills
+    if (!usbHostAway) usbImageService();
+    if (replayRecords > 0) replayService(UINT32_MAX);
+}
+
+void sendOutputStatus() {
+    hostPrintf("QOS_OK:hi=%u lo=%u wm=%u shed=%lu bleShed=%lu away=%d\n",
+               outputQueues[OUTPUT_CLASS_PRIORITY].count, outputQueues[OUTPUT_CLASS_BULK].count,
+               outputWatermark, packetsShed, bleShed, usbHostAway ? 1 : 0);
+}
+#else
+void initUsbHostEvents() {}
+void usbFlush() {}
+void sendLinkStatus() { hostPrintf("LINK_ERR:Built without the USB sink\n"); }
+void outputInit() {}
+void outputService() {}
+uint8_t outputQueued() { return 0; }
+void sendOutputStatus() { hostPrintf("QOS_ERR:Built without the USB sink\n"); }
+#endif
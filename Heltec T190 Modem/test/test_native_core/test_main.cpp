@@ -0,0 +1,398 @@
+/*
+ * RaptorCore host tests: pio test -e test_native
+ *
+ * Covers the code the board and the host share: CFG parsing and the command
+ * line reader, the v1/v2 frame encoders, both CRC32 engines and the CRC16, and
+ * the loop() scheduler's yield and skip rules against a fake clock.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <unity.h>
+
+#include "raptor_crc.h"
+#include "raptor_frame.h"
+#include "raptor_parse.h"
+#include "raptor_sched.h"
+
+static const uint8_t CHECK_INPUT[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+// Strip the delimiters and undo the escaping; returns the body length or -1 if malformed
+static int unstuffFrame(const uint8_t* frame, size_t len, uint8_t* out) {
+    if (len < 2 || frame[0] != FRAME_DELIMITER || frame[len - 1] != FRAME_DELIMITER) return -1;
+    int n = 0;
+    for (size_t i = 1; i < len - 1; i++) {
+        uint8_t b = frame[i];
+        if (b == FRAME_DELIMITER) return -1;
+        if (b == FRAME_ESCAPE) {
+            if (++i >= len - 1) return -1;
+            b = frame[i] ^ 0x20;
+        }
+        out[n++] = b;
+    }
+    return n;
+}
+
+static uint16_t crc16Of(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) crc = crc16Update(crc, data[i]);
+    return crc;
+}
+
+static uint32_t readBe(const uint8_t* p, int bytes) {
+    uint32_t v = 0;
+    for (int i = 0; i < bytes; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+// Payload with both frame control bytes in it, so stuffing is exercised
+static void fillPayload(uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) data[i] = (uint8_t)(i * 37 + 11);
+    if (len > 2) {
+        data[0] = FRAME_DELIMITER;
+        data[1] = FRAME_ESCAPE;
+    }
+}
+
+// ============================================================================
+// raptor_parse
+// ============================================================================
+
+static void test_cfg_parse_valid() {
+    RfConfig cfg;
+    TEST_ASSERT_TRUE(rfConfigParse("CFG:433.125,9.6,5.0,39.0,32", &cfg));
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 433.125f, cfg.frequency);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 9.6f, cfg.bitrate);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 5.0f, cfg.deviation);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 39.0f, cfg.rxBandwidth);
+    TEST_ASSERT_EQUAL_UINT16(32, cfg.preambleLen);
+    TEST_ASSERT_NULL(rfConfigInvalidField(cfg));
+}
+
+static void test_cfg_parse_syntax_errors() {
+    RfConfig cfg;
+    TEST_ASSERT_FALSE(rfConfigParse("CFG:", &cfg));
+    TEST_ASSERT_FALSE(rfConfigParse("CFG:433.125,9.6,5.0,39.0", &cfg));
+    TEST_ASSERT_FALSE(rfConfigParse("CFG:433.125,9.6,5.0,39.0,32,1", &cfg));
+    TEST_ASSERT_FALSE(rfConfigParse("CFG:433.125,abc,5.0,39.0,32", &cfg));
+    TEST_ASSERT_FALSE(rfConfigParse("CFG:433.125,9.6,5.0,39.0,32x", &cfg));
+    TEST_ASSERT_FALSE(rfConfigParse("FOO:433.125,9.6,5.0,39.0,32", &cfg));
+}
+
+static void test_cfg_invalid_field() {
+    RfConfig cfg;
+    TEST_ASSERT_TRUE(rfConfigParse("CFG:100.0,9.6,5.0,39.0,32", &cfg));
+    TEST_ASSERT_NOT_NULL(rfConfigInvalidField(cfg));
+    TEST_ASSERT_TRUE(rfConfigParse("CFG:433.125,301,5.0,39.0,32", &cfg));
+    TEST_ASSERT_NOT_NULL(rfConfigInvalidField(cfg));
+    TEST_ASSERT_TRUE(rfConfigParse("CFG:433.125,9.6,0,39.0,32", &cfg));
+    TEST_ASSERT_NOT_NULL(rfConfigInvalidField(cfg));
+    TEST_ASSERT_TRUE(rfConfigParse("CFG:433.125,9.6,5.0,600,32", &cfg));
+    TEST_ASSERT_NOT_NULL(rfConfigInvalidField(cfg));
+    TEST_ASSERT_TRUE(rfConfigParse("CFG:433.125,9.6,5.0,39.0,4", &cfg));
+    TEST_ASSERT_NOT_NULL(rfConfigInvalidField(cfg));
+    // Out of the uint16 range is reported as an invalid preamble, not wrapped
+    TEST_ASSERT_TRUE(rfConfigParse("CFG:433.125,9.6,5.0,39.0,70000", &cfg));
+    TEST_ASSERT_EQUAL_UINT16(0, cfg.preambleLen);
+    TEST_ASSERT_NOT_NULL(rfConfigInvalidField(cfg));
+}
+
+static CommandFeedResult feedString(CommandParser* parser, const char* s) {
+    CommandFeedResult result = COMMAND_PENDING;
+    for (; *s; s++) {
+        result = commandParserFeed(parser, *s);
+        if (result != COMMAND_PENDING) break;
+    }
+    return result;
+}
+
+static void test_command_parser_lines() {
+    CommandParser parser;
+    memset(&parser, 0, sizeof(parser));
+
+    TEST_ASSERT_EQUAL(COMMAND_PENDING, feedString(&parser, "\r\n\n"));
+    TEST_ASSERT_EQUAL(COMMAND_READY, feedString(&parser, "STATUS\r"));
+    TEST_ASSERT_EQUAL_STRING("STATUS", parser.line);
+    // The \n of a CRLF pair is an empty line
+    TEST_ASSERT_EQUAL(COMMAND_PENDING, commandParserFeed(&parser, '\n'));
+    TEST_ASSERT_EQUAL(COMMAND_READY, feedString(&parser, "CFG:433.125,9.6,5.0,39.0,32\n"));
+    TEST_ASSERT_EQUAL_STRING("CFG:433.125,9.6,5.0,39.0,32", parser.line);
+}
+
+static void test_command_parser_too_long() {
+    CommandParser parser;
+    memset(&parser, 0, sizeof(parser));
+    char line[HOST_CMD_MAX_LEN + 2];
+
+    // The longest line that fits
+    memset(line, 'A', HOST_CMD_MAX_LEN - 1);
+    line[HOST_CMD_MAX_LEN - 1] = '\n';
+    line[HOST_CMD_MAX_LEN] = '\0';
+    TEST_ASSERT_EQUAL(COMMAND_READY, feedString(&parser, line));
+    TEST_ASSERT_EQUAL(HOST_CMD_MAX_LEN - 1, strlen(parser.line));
+
+    // One more is rejected whole, and the next line is read normally
+    memset(line, 'B', HOST_CMD_MAX_LEN);
+    line[HOST_CMD_MAX_LEN] = '\n';
+    line[HOST_CMD_MAX_LEN + 1] = '\0';
+    TEST_ASSERT_EQUAL(COMMAND_TOO_LONG, feedString(&parser, line));
+    TEST_ASSERT_EQUAL(COMMAND_READY, feedString(&parser, "PING\n"));
+    TEST_ASSERT_EQUAL_STRING("PING", parser.line);
+}
+
+// ============================================================================
+// raptor_crc
+// ============================================================================
+
+static void test_crc32_check_value() {
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32Bitwise(CHECK_INPUT, sizeof(CHECK_INPUT)));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32Slice8(CHECK_INPUT, sizeof(CHECK_INPUT)));
+}
+
+// Every length up to past a full packet, and every start alignment slice8 can see
+static void test_crc32_engines_agree() {
+    uint8_t data[300 + 8];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 131 + 7);
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t len = 0; len <= 300; len++) {
+            TEST_ASSERT_EQUAL_HEX32(crc32Bitwise(data + offset, len), crc32Slice8(data + offset, len));
+        }
+    }
+}
+
+static void test_crc16_check_value() {
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16Of(CHECK_INPUT, sizeof(CHECK_INPUT)));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, crc16Of(CHECK_INPUT, 0));
+}
+
+// ============================================================================
+// raptor_frame
+// ============================================================================
+
+static void test_frame_v1_round_trip() {
+    uint8_t data[64];
+    fillPayload(data, sizeof(data));
+    uint8_t frame[FRAME_MAX_SIZE];
+    uint8_t body[FRAME_MAX_SIZE];
+
+    size_t len = buildFrame(frame, data, sizeof(data), -87.25f, 6.5f);
+    TEST_ASSERT_TRUE(len <= FRAME_MAX_SIZE);
+    int n = unstuffFrame(frame, len, body);
+    TEST_ASSERT_EQUAL(FRAME_HEADER_SIZE + (int)sizeof(data) + 1, n);
+
+    TEST_ASSERT_EQUAL_UINT16(sizeof(data), readBe(body, 2));
+    TEST_ASSERT_EQUAL_INT8(-87, (int8_t)body[2]);
+    TEST_ASSERT_EQUAL_UINT8(25, body[3]);
+    TEST_ASSERT_EQUAL_INT8(6, (int8_t)body[4]);
+    TEST_ASSERT_EQUAL_UINT8(50, body[5]);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, body + FRAME_HEADER_SIZE, sizeof(data));
+
+    uint8_t checksum = 0;
+    for (int i = 0; i < n - 1; i++) checksum ^= body[i];
+    TEST_ASSERT_EQUAL_HEX8(checksum, body[n - 1]);
+}
+
+static void test_frame_v1_snr_none() {
+    uint8_t data[4] = { 1, 2, 3, 4 };
+    uint8_t frame[FRAME_MAX_SIZE];
+    uint8_t body[FRAME_MAX_SIZE];
+
+    size_t len = buildFrame(frame, data, sizeof(data), -100.0f, NAN);
+    int n = unstuffFrame(frame, len, body);
+    TEST_ASSERT_EQUAL(FRAME_HEADER_SIZE + (int)sizeof(data) + 1, n);
+    TEST_ASSERT_EQUAL_INT8(FRAME_V1_SNR_NONE, (int8_t)body[4]);
+    TEST_ASSERT_EQUAL_UINT8(0, body[5]);
+}
+
+static void test_frame_v2_round_trip() {
+    RxSlot slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.rxMicros = 0x0123456789ABCDEFLL;
+    slot.len = 255;
+    slot.rssi = -92.37f;
+    slot.snr = NAN;
+    fillPayload(slot.data, slot.len);
+    uint8_t frame[FRAME_MAX_SIZE];
+    uint8_t body[FRAME_MAX_SIZE];
+
+    size_t len = buildFrameV2(frame, &slot, 0x7E7D0102);
+    TEST_ASSERT_TRUE(len <= FRAME_MAX_SIZE);
+    int n = unstuffFrame(frame, len, body);
+    TEST_ASSERT_EQUAL(FRAME_V2_HEADER_SIZE + slot.len + 2, n);
+
+    TEST_ASSERT_EQUAL_HEX8(FRAME_V2_TAG, body[0]);
+    TEST_ASSERT_EQUAL_UINT16(slot.len, readBe(body + 1, 2));
+    TEST_ASSERT_EQUAL_HEX32(0x7E7D0102, readBe(body + 3, 4));
+    TEST_ASSERT_EQUAL_HEX32(0x01234567, readBe(body + 7, 4));
+    TEST_ASSERT_EQUAL_HEX32(0x89ABCDEF, readBe(body + 11, 4));
+    TEST_ASSERT_EQUAL_INT16(-9237, (int16_t)readBe(body + 15, 2));
+    TEST_ASSERT_EQUAL_INT16(FRAME_CDB_NONE, (int16_t)readBe(body + 17, 2));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(slot.data, body + FRAME_V2_HEADER_SIZE, slot.len);
+
+    TEST_ASSERT_EQUAL_HEX16(crc16Of(body, n - 2), readBe(body + n - 2, 2));
+    // CRC16 over the body including its own CRC is zero for a non-reflected CRC
+    TEST_ASSERT_EQUAL_HEX16(0, crc16Of(body, n));
+}
+
+static void test_tagged_frame_crc() {
+    uint8_t payload[16];
+    fillPayload(payload, sizeof(payload));
+    uint8_t frame[FRAME_TAGGED_MAX_SIZE(sizeof(payload))];
+    uint8_t body[sizeof(frame)];
+
+    size_t len = buildTaggedFrame(frame, FRAME_STATS_TAG, payload, sizeof(payload));
+    TEST_ASSERT_TRUE(len <= sizeof(frame));
+    int n = unstuffFrame(frame, len, body);
+    TEST_ASSERT_EQUAL(3 + (int)sizeof(payload) + 2, n);
+    TEST_ASSERT_EQUAL_HEX8(FRAME_STATS_TAG, body[0]);
+    TEST_ASSERT_EQUAL_UINT16(sizeof(payload), readBe(body + 1, 2));
+    TEST_ASSERT_EQUAL_HEX16(crc16Of(body, n - 2), readBe(body + n - 2, 2));
+}
+
+// ============================================================================
+// raptor_sched
+// ============================================================================
+
+static uint32_t fakeNow;
+static bool fakeYield;
+static char runLog[64];
+static size_t runLogLen;
+
+static uint32_t fakeClock() { return fakeNow; }
+static bool fakeShouldYield() { return fakeYield; }
+
+static void logRun(char c) {
+    if (runLogLen < sizeof(runLog) - 1) runLog[runLogLen++] = c;
+    runLog[runLogLen] = '\0';
+}
+static void jobA() { logRun('A'); }
+static void jobB() { logRun('B'); }
+static void jobC() { logRun('C'); }
+
+static void schedReset(Scheduler* s, uint32_t passBudgetUs) {
+    fakeNow = 1000;
+    fakeYield = false;
+    runLogLen = 0;
+    runLog[0] = '\0';
+    schedInit(s, passBudgetUs, fakeClock, fakeShouldYield);
+}
+
+static void test_sched_priority_order() {
+    Scheduler s;
+    schedReset(&s, 100000);
+    schedAdd(&s, "low", jobC, 1, SCHED_IDLE, 10);
+    schedAdd(&s, "high", jobA, 3, SCHED_IDLE, 10);
+    schedAdd(&s, "mid", jobB, 2, SCHED_IDLE, 10);
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_STRING("ABC", runLog);
+    TEST_ASSERT_EQUAL_UINT32(1, s.passes);
+}
+
+static void test_sched_period() {
+    Scheduler s;
+    schedReset(&s, 100000);
+    SchedJob* job = schedAdd(&s, "tick", jobA, 1, 500, 10);
+
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_UINT32(0, job->runs);       // First due one period after schedAdd
+    TEST_ASSERT_EQUAL_UINT32(500, schedNextDueUs(&s));
+    fakeNow += 499;
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_UINT32(0, job->runs);
+    fakeNow += 1;
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_UINT32(1, job->runs);
+
+    // Missed periods are not caught up
+    fakeNow += 5000;
+    schedPass(&s);
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_UINT32(2, job->runs);
+    TEST_ASSERT_EQUAL_UINT32(500, schedNextDueUs(&s));
+}
+
+static void test_sched_yield_skips_then_forces() {
+    Scheduler s;
+    schedReset(&s, 100000);
+    SchedJob* first = schedAdd(&s, "cmd", jobA, 3, SCHED_IDLE, 10);
+    SchedJob* second = schedAdd(&s, "stats", jobB, 2, SCHED_IDLE, 10);
+    fakeYield = true;
+
+    // The first due job always runs; the rest wait for the packet path
+    for (int pass = 0; pass < SCHED_MAX_YIELD_SKIPS; pass++) {
+        schedPass(&s);
+        TEST_ASSERT_EQUAL_UINT32(pass + 1, first->runs);
+        TEST_ASSERT_EQUAL_UINT32(0, second->runs);
+    }
+    TEST_ASSERT_EQUAL_UINT32(SCHED_MAX_YIELD_SKIPS, second->deferred);
+    TEST_ASSERT_EQUAL_UINT32(SCHED_MAX_YIELD_SKIPS, s.yields);
+
+    // ...but only for SCHED_MAX_YIELD_SKIPS passes in a row
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_UINT32(1, second->runs);
+    TEST_ASSERT_EQUAL_UINT32(1, second->forced);
+    TEST_ASSERT_EQUAL_UINT8(0, second->yieldSkips);
+
+    // A pass without a yield runs everything and resets nothing further
+    fakeYield = false;
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_UINT32(2, second->runs);
+    TEST_ASSERT_EQUAL_UINT32(1, second->forced);
+}
+
+static void test_sched_no_yield_callback() {
+    Scheduler s;
+    schedReset(&s, 100000);
+    s.shouldYield = nullptr;
+    schedAdd(&s, "cmd", jobA, 3, SCHED_IDLE, 10);
+    schedAdd(&s, "stats", jobB, 2, SCHED_IDLE, 10);
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_STRING("AB", runLog);
+    TEST_ASSERT_EQUAL_UINT32(0, s.yields);
+}
+
+static void test_sched_budget_holds_once() {
+    Scheduler s;
+    schedReset(&s, 100);
+    schedAdd(&s, "cmd", jobA, 3, SCHED_IDLE, 10);
+    SchedJob* big = schedAdd(&s, "scan", jobB, 1, SCHED_IDLE, 200);
+
+    // Over the pass budget behind another job: deferred once, then run first thing
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_UINT32(0, big->runs);
+    TEST_ASSERT_EQUAL_UINT32(1, big->deferred);
+    schedPass(&s);
+    TEST_ASSERT_EQUAL_UINT32(1, big->runs);
+}
+
+int main() {
+    crc16Init();
+    crc32Slice8Init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_cfg_parse_valid);
+    RUN_TEST(test_cfg_parse_syntax_errors);
+    RUN_TEST(test_cfg_invalid_field);
+    RUN_TEST(test_command_parser_lines);
+    RUN_TEST(test_command_parser_too_long);
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_crc32_engines_agree);
+    RUN_TEST(test_crc16_check_value);
+    RUN_TEST(test_frame_v1_round_trip);
+    RUN_TEST(test_frame_v1_snr_none);
+    RUN_TEST(test_frame_v2_round_trip);
+    RUN_TEST(test_tagged_frame_crc);
+    RUN_TEST(test_sched_priority_order);
+    RUN_TEST(test_sched_period);
+    RUN_TEST(test_sched_yield_skips_then_forces);
+    RUN_TEST(test_sched_no_yield_callback);
+    RUN_TEST(test_sched_budget_holds_once);
+    return UNITY_END();
+}